@@ -0,0 +1,612 @@
+// Benchmarks Ptr against the std::shared_ptr / std::unique_ptr equivalent of
+// each operation. Every row pairs the two timings, in nanoseconds per
+// operation (best of up to five runs), so results can be diffed between releases.
+//
+//   bench [--format=csv|json] [--scale=N]
+//
+// --scale multiplies the operation counts (default 1).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/vector.hpp>
+#include "ptr.h"
+
+using namespace std;
+
+struct Payload {
+    int value;
+    explicit Payload(int value = 0) : value(value) {}
+};
+
+struct Base {
+    int value = 0;
+    virtual ~Base() {}
+};
+
+struct Derived : Base {
+    int extra = 0;
+};
+
+template <typename T>
+inline void DoNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+    string benchmark;
+    int threads;
+    size_t ops;
+    string ptr;
+    double ptr_ns;
+    string baseline;
+    double baseline_ns;
+};
+
+static vector<Result> results;
+static double scale = 1.0;
+
+// Best time per operation over up to five runs of body(ops), stopping early
+// once the runs have taken a few seconds
+static double Measure(size_t ops, const function<void(size_t)>& body) {
+    const int runs = 5;
+    const double budget_ns = 3e9;
+    double best = 0, total = 0;
+    for (int run = 0; run < runs && total < budget_ns; ++run) {
+        auto start = chrono::steady_clock::now();
+        body(ops);
+        auto end = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double, nano>(end - start).count();
+        total += elapsed;
+        if (run == 0 || elapsed / ops < best) best = elapsed / ops;
+    }
+    return best;
+}
+
+// ops is scaled and then rounded to a whole, nonzero number of batches per
+// thread, so bodies that work in passes over batch items do exactly ops
+static void Compare(const string& benchmark, size_t ops,
+                    const string& ptr, const function<void(size_t)>& ptrBody,
+                    const string& baseline, const function<void(size_t)>& baselineBody,
+                    int threads = 1, size_t batch = 1) {
+    size_t unit = batch * threads;
+    ops = max<size_t>(1, size_t(ops * scale) / unit) * unit;
+    double ptrNs = Measure(ops, ptrBody);
+    double baselineNs = Measure(ops, baselineBody);
+    results.push_back({benchmark, threads, ops, ptr, ptrNs, baseline, baselineNs});
+}
+
+// Runs body(ops / threads) on each of threads threads at once
+static function<void(size_t)> Parallel(int threads, function<void(size_t)> body) {
+    return [threads, body](size_t ops) {
+        vector<thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back(body, ops / threads);
+        for (auto& worker : workers) worker.join();
+    };
+}
+
+static void BenchMakeDestroy() {
+    Compare("make_destroy", 2000000,
+        "Ptr::Make", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(Ptr<Payload>::Make(int(i)));
+        },
+        "std::make_shared", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(make_shared<Payload>(int(i)));
+        });
+
+    Compare("make_destroy_pool", 2000000,
+        "Ptr::AllocateWith<Pool>", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(Ptr<Payload>::AllocateWith<Pool>(int(i)));
+        },
+        "std::make_shared", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(make_shared<Payload>(int(i)));
+        });
+
+    Compare("make_destroy_unique", 2000000,
+        "Ptr::Make", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(Ptr<Payload>::Make(int(i)));
+        },
+        "std::make_unique", [](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(make_unique<Payload>(int(i)));
+        });
+}
+
+static void BenchCopyMove() {
+    auto ptr = Ptr<Payload>::Make(1);
+    auto shared = SharedPtr<Payload>::Make(1);
+    auto stdShared = make_shared<Payload>(1);
+
+    Compare("copy", 10000000,
+        "Ptr", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) {
+                Ptr<Payload> copy(ptr);
+                DoNotOptimize(copy);
+            }
+        },
+        "std::shared_ptr", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) {
+                shared_ptr<Payload> copy(stdShared);
+                DoNotOptimize(copy);
+            }
+        });
+
+    // libstdc++ only switches shared_ptr to atomic counts once a second thread
+    // has been started, so before BenchThreads this baseline is non-atomic
+    Compare("copy_atomic", 10000000,
+        "SharedPtr", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) {
+                SharedPtr<Payload> copy(shared);
+                DoNotOptimize(copy);
+            }
+        },
+        "std::shared_ptr", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) {
+                shared_ptr<Payload> copy(stdShared);
+                DoNotOptimize(copy);
+            }
+        });
+
+    Compare("move", 10000000,
+        "Ptr", [&](size_t ops) {
+            Ptr<Payload> a = ptr, b;
+            for (size_t i = 0; i < ops; ++i) {
+                b = std::move(a);
+                a = std::move(b);
+                DoNotOptimize(a);
+            }
+        },
+        "std::shared_ptr", [&](size_t ops) {
+            shared_ptr<Payload> a = stdShared, b;
+            for (size_t i = 0; i < ops; ++i) {
+                b = std::move(a);
+                a = std::move(b);
+                DoNotOptimize(a);
+            }
+        });
+}
+
+static void BenchCast() {
+    auto derived = Ptr<Derived>::Make();
+    auto base = derived.Cast<Base>();
+    auto stdDerived = make_shared<Derived>();
+    shared_ptr<Base> stdBase = stdDerived;
+
+    Compare("cast_up", 5000000,
+        "Ptr::Cast<Base>", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(derived.Cast<Base>());
+        },
+        "std::static_pointer_cast", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(static_pointer_cast<Base>(stdDerived));
+        });
+
+    Compare("cast_down", 5000000,
+        "Ptr::Cast<Derived>", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(base.Cast<Derived>());
+        },
+        "std::dynamic_pointer_cast", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(dynamic_pointer_cast<Derived>(stdBase));
+        });
+
+    Compare("cast_down_static", 5000000,
+        "Ptr::StaticCast<Derived>", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(base.StaticCast<Derived>());
+        },
+        "std::static_pointer_cast", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(static_pointer_cast<Derived>(stdBase));
+        });
+
+    // The baseline demangles on every call, as Type() used to
+    Compare("type_name", 1000000,
+        "Ptr::Type", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(base.Type().size());
+        },
+        "abi::__cxa_demangle", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) {
+                int status;
+                char* demangled = abi::__cxa_demangle(typeid(*stdBase).name(), nullptr, nullptr, &status);
+                string name(demangled);
+                ::free(demangled);
+                DoNotOptimize(name.size());
+            }
+        });
+}
+
+static void BenchArrays() {
+    const size_t length = 4096;
+
+    Compare("array_make_destroy", 500000,
+        "Ptr<float[]>::MakeAligned<64>", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(Ptr<float[]>::MakeAligned<64>(length).data());
+        },
+        "std::make_shared<float[]>", [&](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(make_shared<float[]>(length).get());
+        });
+
+    auto ptrArray = Ptr<float[]>::MakeAligned<64>(length);
+    auto stdVector = make_shared<vector<float>>(length);
+    for (size_t i = 0; i < length; ++i) ptrArray[i] = (*stdVector)[i] = float(i % 7);
+
+    // ops counts elements summed; the baseline is the Ptr<vector<T>> pattern
+    Compare("array_sum", length * 20000,
+        "Ptr<float[]>::Span", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / length; ++pass) {
+                float sum = 0;
+                for (float f : ptrArray.Span()) sum += f;
+                DoNotOptimize(sum);
+            }
+        },
+        "std::shared_ptr<std::vector<float>>", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / length; ++pass) {
+                float sum = 0;
+                for (float f : *stdVector) sum += f;
+                DoNotOptimize(sum);
+            }
+        }, 1, length);
+}
+
+static void BenchContainers() {
+    const size_t count = 100000;
+    vector<int> values(count);
+    iota(values.begin(), values.end(), 0);
+    shuffle(values.begin(), values.end(), mt19937(42));
+
+    vector<Ptr<Payload>> ptrs;
+    vector<Ref<Payload>> refs;
+    vector<shared_ptr<Payload>> stds;
+    for (int value : values) {
+        ptrs.push_back(Ptr<Payload>::Make(value));
+        refs.push_back(Ref<Payload>(ptrs.back()));
+        stds.push_back(make_shared<Payload>(value));
+    }
+
+    // ops counts dereferences: each pass walks the whole vector
+    Compare("deref", count * 200,
+        "Ptr::operator->", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (auto& p : ptrs) sum += p->value;
+            DoNotOptimize(sum);
+        },
+        "std::shared_ptr::operator->", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (auto& p : stds) sum += p->value;
+            DoNotOptimize(sum);
+        }, 1, count);
+
+    Compare("deref_unchecked", count * 200,
+        "Ref::operator->", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (auto& r : refs) sum += r->value;
+            DoNotOptimize(sum);
+        },
+        "std::shared_ptr::operator->", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (auto& p : stds) sum += p->value;
+            DoNotOptimize(sum);
+        }, 1, count);
+
+    // ops counts elements sorted; each pass sorts a fresh shuffled copy
+    Compare("sort", count * 5,
+        "vector<Ptr>", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / count; ++pass) {
+                auto copy = ptrs;
+                sort(copy.begin(), copy.end(), [](const Ptr<Payload>& a, const Ptr<Payload>& b) {
+                    return a->value < b->value;
+                });
+                DoNotOptimize(copy.front());
+            }
+        },
+        "vector<std::shared_ptr>", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / count; ++pass) {
+                auto copy = stds;
+                sort(copy.begin(), copy.end(), [](const shared_ptr<Payload>& a, const shared_ptr<Payload>& b) {
+                    return a->value < b->value;
+                });
+                DoNotOptimize(copy.front());
+            }
+        }, 1, count);
+}
+
+template <template <typename> class Pointer>
+struct GraphNode {
+    int value = 0;
+    vector<Pointer<GraphNode>> edges;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & value;
+        ar & edges;
+    }
+};
+
+template <typename T>
+using PtrOf = Ptr<T>;
+
+template <typename T>
+using StdOf = shared_ptr<T>;
+
+// Each node links to its predecessor and to one earlier node, so every node
+// but the last is shared and archive recursion stays shallow
+template <template <typename> class Pointer, typename MakeNode>
+static vector<Pointer<GraphNode<Pointer>>> BuildGraph(size_t count, MakeNode make) {
+    mt19937 random(7);
+    vector<Pointer<GraphNode<Pointer>>> nodes;
+    nodes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto node = make();
+        node->value = int(i);
+        if (i > 0) node->edges.push_back(nodes[i - 1]);
+        if (i > 1) node->edges.push_back(nodes[random() % (i - 1)]);
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+template <typename Graph>
+static string SaveGraph(const Graph& graph) {
+    stringstream stream;
+    boost::archive::binary_oarchive oa(stream);
+    oa << graph;
+    return stream.str();
+}
+
+// Pointer-keyed lookups, the common case for identity maps of live objects
+static void BenchMaps() {
+    const size_t count = 100000;
+    vector<Ptr<Payload>> ptrs;
+    vector<shared_ptr<Payload>> stds;
+    for (size_t i = 0; i < count; ++i) {
+        ptrs.push_back(Ptr<Payload>::Make(int(i)));
+        stds.push_back(make_shared<Payload>(int(i)));
+    }
+
+    vector<size_t> order(count);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), mt19937(42));
+
+    // ops counts inserts and erases; each pass fills and empties a map
+    Compare("map_insert_erase", count * 20,
+        "unordered_map<Ptr>", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / (2 * count); ++pass) {
+                unordered_map<Ptr<Payload>, int> map;
+                for (auto& p : ptrs) map.emplace(p, p->value);
+                for (size_t i : order) map.erase(ptrs[i]);
+                DoNotOptimize(map.size());
+            }
+        },
+        "unordered_map<std::shared_ptr>", [&](size_t ops) {
+            for (size_t pass = 0; pass < ops / (2 * count); ++pass) {
+                unordered_map<shared_ptr<Payload>, int> map;
+                for (auto& p : stds) map.emplace(p, p->value);
+                for (size_t i : order) map.erase(stds[i]);
+                DoNotOptimize(map.size());
+            }
+        }, 1, 2 * count);
+
+    unordered_map<Ptr<Payload>, int, PtrHash, PtrEqual> ptrMap;
+    unordered_map<shared_ptr<Payload>, int> stdMap;
+    for (size_t i = 0; i < count; ++i) {
+        ptrMap.emplace(ptrs[i], int(i));
+        stdMap.emplace(stds[i], int(i));
+    }
+    vector<Payload*> ptrRaw, stdRaw;
+    for (size_t i : order) {
+        ptrRaw.push_back(&*ptrs[i]);
+        stdRaw.push_back(stds[i].get());
+    }
+
+    // The std baseline looks up through a non-owning aliasing shared_ptr,
+    // the cheapest way to search a shared_ptr-keyed map by raw pointer
+    Compare("map_find_raw", count * 50,
+        "unordered_map<Ptr>::find(T*)", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (Payload* raw : ptrRaw) sum += ptrMap.find(raw)->second;
+            DoNotOptimize(sum);
+        },
+        "unordered_map<std::shared_ptr>::find", [&](size_t ops) {
+            long sum = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (Payload* raw : stdRaw) sum += stdMap.find(shared_ptr<Payload>(shared_ptr<Payload>(), raw))->second;
+            DoNotOptimize(sum);
+        }, 1, count);
+
+    // Binary search of a sorted flat vector of keys by raw pointer
+    vector<Ptr<Payload>> ptrSorted = ptrs;
+    vector<shared_ptr<Payload>> stdSorted = stds;
+    sort(ptrSorted.begin(), ptrSorted.end(), PtrLess());
+    sort(stdSorted.begin(), stdSorted.end());
+    Compare("flat_find_raw", count * 50,
+        "vector<Ptr> + PtrLess", [&](size_t ops) {
+            long found = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (Payload* raw : ptrRaw)
+                    found += *lower_bound(ptrSorted.begin(), ptrSorted.end(), raw, PtrLess()) == raw;
+            DoNotOptimize(found);
+        },
+        "vector<std::shared_ptr> + get()", [&](size_t ops) {
+            long found = 0;
+            for (size_t pass = 0; pass < ops / count; ++pass)
+                for (Payload* raw : stdRaw) {
+                    auto it = lower_bound(stdSorted.begin(), stdSorted.end(), raw,
+                        [](const shared_ptr<Payload>& p, Payload* key) { return less<>()(p.get(), key); });
+                    found += it->get() == raw;
+                }
+            DoNotOptimize(found);
+        }, 1, count);
+}
+
+static void BenchSerialization() {
+    const size_t count = 1000000;
+    size_t nodes = max<size_t>(2, size_t(count * scale));
+    auto ptrGraph = BuildGraph<PtrOf>(nodes, [] { return Ptr<GraphNode<PtrOf>>::Make(); });
+    auto stdGraph = BuildGraph<StdOf>(nodes, [] { return make_shared<GraphNode<StdOf>>(); });
+    string ptrBytes = SaveGraph(ptrGraph);
+    string stdBytes = SaveGraph(stdGraph);
+
+    // ops counts nodes; one pass per graph
+    Compare("serialize_save", count,
+        "Ptr binary_oarchive", [&](size_t) {
+            DoNotOptimize(SaveGraph(ptrGraph).size());
+        },
+        "std::shared_ptr binary_oarchive", [&](size_t) {
+            DoNotOptimize(SaveGraph(stdGraph).size());
+        });
+
+    // Includes tearing the loaded graph down again
+    Compare("serialize_load", count,
+        "Ptr binary_iarchive", [&](size_t) {
+            stringstream stream(ptrBytes);
+            boost::archive::binary_iarchive ia(stream);
+            decltype(ptrGraph) loaded;
+            ia >> loaded;
+            DoNotOptimize(loaded.back());
+        },
+        "std::shared_ptr binary_iarchive", [&](size_t) {
+            stringstream stream(stdBytes);
+            boost::archive::binary_iarchive ia(stream);
+            decltype(stdGraph) loaded;
+            ia >> loaded;
+            DoNotOptimize(loaded.back());
+        });
+}
+
+static void BenchThreads() {
+    auto shared = SharedPtr<Payload>::Make(1);
+    auto stdShared = make_shared<Payload>(1);
+    int hardware = max(2u, thread::hardware_concurrency());
+
+    for (int threads = 2; threads <= hardware; threads *= 2) {
+        Compare("mt_copy", 4000000,
+            "SharedPtr", Parallel(threads, [&](size_t ops) {
+                for (size_t i = 0; i < ops; ++i) {
+                    SharedPtr<Payload> copy(shared);
+                    DoNotOptimize(copy);
+                }
+            }),
+            "std::shared_ptr", Parallel(threads, [&](size_t ops) {
+                for (size_t i = 0; i < ops; ++i) {
+                    shared_ptr<Payload> copy(stdShared);
+                    DoNotOptimize(copy);
+                }
+            }),
+            threads);
+    }
+}
+
+// Readers load the current snapshot while one writer keeps publishing new ones;
+// the threads column counts readers only
+template <typename Slot, typename MakeSnapshot>
+static function<void(size_t)> ReadersWithWriter(int readers, Slot& slot, MakeSnapshot make) {
+    return [readers, &slot, make](size_t ops) {
+        atomic<bool> done{false};
+        thread writer([&] {
+            for (int version = 0; !done; ++version) {
+                slot.store(make(version));
+                this_thread::yield();
+            }
+        });
+        Parallel(readers, [&slot](size_t ops) {
+            for (size_t i = 0; i < ops; ++i) DoNotOptimize(slot.load()->value);
+        })(ops);
+        done = true;
+        writer.join();
+    };
+}
+
+// Gives AtomicPtr the std::atomic spelling used by ReadersWithWriter
+struct PtrSlot {
+    AtomicPtr<Payload> slot{SharedPtr<Payload>::Make(0)};
+    SharedPtr<Payload> load() const { return slot.Load(); }
+    void store(SharedPtr<Payload> value) { slot.Store(std::move(value)); }
+};
+
+static void BenchAtomicSlot() {
+    PtrSlot ptrSlot;
+    atomic<shared_ptr<Payload>> stdSlot{make_shared<Payload>(0)};
+    int hardware = max(2u, thread::hardware_concurrency());
+
+    for (int readers = 1; readers <= hardware; readers *= 2) {
+        Compare("atomic_load", 2000000,
+            "AtomicPtr::Load", ReadersWithWriter(readers, ptrSlot, [](int version) {
+                return SharedPtr<Payload>::Make(version);
+            }),
+            "std::atomic<std::shared_ptr>::load", ReadersWithWriter(readers, stdSlot, [](int version) {
+                return make_shared<Payload>(version);
+            }),
+            readers);
+    }
+}
+
+static void Print(const string& format) {
+    if (format == "json") {
+        cout << "[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            cout << "  {\"benchmark\": \"" << r.benchmark << "\", \"threads\": " << r.threads
+                 << ", \"ops\": " << r.ops
+                 << ", \"ptr\": \"" << r.ptr << "\", \"ptr_ns\": " << r.ptr_ns
+                 << ", \"baseline\": \"" << r.baseline << "\", \"baseline_ns\": " << r.baseline_ns
+                 << ", \"ratio\": " << r.ptr_ns / r.baseline_ns << "}"
+                 << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        cout << "]" << endl;
+        return;
+    }
+
+    cout << "benchmark,threads,ops,ptr,ptr_ns,baseline,baseline_ns,ratio\n";
+    for (const Result& r : results) {
+        cout << r.benchmark << "," << r.threads << "," << r.ops << ","
+             << r.ptr << "," << r.ptr_ns << ","
+             << r.baseline << "," << r.baseline_ns << ","
+             << r.ptr_ns / r.baseline_ns << "\n";
+    }
+    cout.flush();
+}
+
+int main(int argc, char** argv) {
+    string format = "csv";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--format=", 0) == 0) {
+            format = arg.substr(9);
+        } else if (arg.rfind("--scale=", 0) == 0) {
+            scale = atof(arg.substr(8).c_str());
+        } else {
+            cerr << "usage: " << argv[0] << " [--format=csv|json] [--scale=N]" << endl;
+            return 1;
+        }
+    }
+
+    BenchMakeDestroy();
+    BenchCopyMove();
+    BenchCast();
+    BenchContainers();
+    BenchMaps();
+    BenchArrays();
+    BenchSerialization();
+    BenchThreads();
+    BenchAtomicSlot();
+
+    Print(format);
+    return 0;
+}
@@ -1,7 +1,47 @@
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <sstream>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/export.hpp>
+#include <boost/serialization/vector.hpp>
 #include "ptr.h"
 
+// Count heap allocations so tests can check how many Make performs
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(std::size_t size) {
+    ++allocationCount;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    ++allocationCount;
+    size_t alignment = static_cast<size_t>(align);
+    size_t rounded = size ? (size + alignment - 1) / alignment * alignment : alignment;
+    if (void* p = std::aligned_alloc(alignment, rounded)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
 void testPtrFunction() {
     // Test Default Construction
     {
@@ -9,14 +49,16 @@ void testPtrFunction() {
         assert(!p);
         assert(p.Count() == 0);
         assert(p.Type() == "Null");
-        try {
-            *p;
-            assert(false); // Should not reach here
-        } catch (const UninitializedPointer& e) {}
-        try {
-            p.operator->();
-            assert(false);
-        } catch (const UninitializedPointer& e) {}
+        if constexpr (ptr_detail::checked_dereference) {
+            try {
+                *p;
+                assert(false); // Should not reach here
+            } catch (const UninitializedPointer& e) {}
+            try {
+                p.operator->();
+                assert(false);
+            } catch (const UninitializedPointer& e) {}
+        }
     }
 
     // Test Make Factory and Basic Functionality
@@ -94,6 +136,46 @@ void testPtrFunction() {
         assert(unrelatedPtr == nullptr);
     }
 
+    // Test static and const casts share the count
+    {
+        struct Base { int value = 1; virtual ~Base() {} };
+        struct Derived : Base { int extra = 2; };
+        struct Plain { int value = 3; };
+        struct PlainDerived : Plain {};
+
+        auto derived = Ptr<Derived>::Make();
+        Ptr<Base> base = derived.Cast<Base>();
+        auto back = base.StaticCast<Derived>();
+        assert(back == derived);
+        assert(back->extra == 2);
+        assert(derived.Count() == 3);
+
+        // Upcasts need no RTTI
+        auto plain = Ptr<PlainDerived>::Make().Cast<Plain>();
+        assert(plain && plain->value == 3);
+        assert(plain.Unique());
+
+        Ptr<const Derived> constant = derived.ConstCast<const Derived>();
+        Ptr<Derived> mutableAgain = constant.ConstCast<Derived>();
+        mutableAgain->extra = 5;
+        assert(constant->extra == 5);
+        assert(derived.Count() == 5);
+
+        assert(Ptr<Base>().StaticCast<Derived>() == nullptr);
+    }
+
+    // Test Type names are cached per dynamic type
+    {
+        struct Base { virtual ~Base() {} };
+        struct Derived : Base {};
+        auto derived = Ptr<Derived>::Make();
+        Ptr<Base> base = derived.Cast<Base>();
+        assert(base.Type().find("Derived") != std::string::npos);
+        assert(&base.Type() == &derived.Type());
+        assert(&Ptr<Base>::Make().Type() != &base.Type());
+        assert(&Ptr<int>().Type() == &Ptr<double>().Type());
+    }
+
     // Test Exceptions
     {
         Ptr<int> nullPtr;
@@ -125,10 +207,1008 @@ void testPtrFunction() {
         assert(!p2.Unique());
     }
 
+    // Test Ref is non-null by construction and dereferences without checks
+    {
+        static_assert(noexcept(*std::declval<Ptr<int>&>()) == !ptr_detail::checked_dereference);
+        static_assert(noexcept(*std::declval<Ref<int>&>()));
+        static_assert(!std::is_default_constructible_v<Ref<int>>);
+
+        auto r = Ref<int>::Make(8);
+        assert(*r == 8);
+        assert(r.Unique());
+
+        Ref<int> copy = r;
+        Ref<int> moved = std::move(copy);
+        assert(*copy == 8);
+        assert(r.Count() == 3);
+
+        auto p = Ptr<std::string>::Make("ref");
+        Ref<std::string> fromPtr(p);
+        assert(fromPtr->size() == 3);
+        const Ptr<std::string>& back = fromPtr;
+        assert(back.Count() == 2);
+
+        try {
+            Ref<int> fromNull{Ptr<int>()};
+            assert(false);
+        } catch (const UninitializedPointer&) {}
+    }
+
+    // Test Make allocates object and count together
+    {
+        size_t before = allocationCount;
+        auto p1 = Ptr<std::pair<int, double>>::Make(1, 2.0);
+        assert(allocationCount - before == 1);
+        auto p2 = p1;
+        auto p3 = std::move(p2);
+        assert(allocationCount - before == 1);
+        assert(p1->first == 1 && p3->second == 2.0);
+
+        before = allocationCount;
+        Ptr<std::pair<int, double>> p4(std::make_pair(3, 4.0));
+        assert(allocationCount - before == 1);
+        assert(p4->first == 3);
+    }
+
+    // Test over-aligned types keep their alignment inside the block
+    {
+        struct alignas(64) Wide { char bytes[64]; };
+        auto p = Ptr<Wide>::Make();
+        assert(reinterpret_cast<uintptr_t>(&*p) % 64 == 0);
+    }
+
+    // Test destruction happens once, through the last reference
+    {
+        static int destroyed = 0;
+        struct Tracked { ~Tracked() { ++destroyed; } };
+        auto p1 = Ptr<Tracked>::Make();
+        auto p2 = p1;
+        p1 = nullptr;
+        assert(!p1);
+        assert(p2.Count() == 1);
+        assert(destroyed == 0);
+        p2.free();
+        assert(destroyed == 1);
+    }
+
+    // Test assigning from a Ptr owned by the object being released
+    {
+        static int destroyed = 0;
+        struct Node {
+            Ptr<Node> next;
+            ~Node() { ++destroyed; }
+        };
+        Ptr<Node> head = Ptr<Node>::Make();
+        head->next = Ptr<Node>::Make();
+        head->next->next = Ptr<Node>::Make();
+        head = head->next;
+        assert(destroyed == 1 && head->next);
+        head = std::move(head->next);
+        assert(destroyed == 2 && head.Unique() && !head->next);
+
+        WeakPtr<Node> weak(head);
+        weak = weak;
+        weak = std::move(weak);
+        assert(weak.Lock() == head);
+        head = head;
+        head = std::move(head);
+        assert(head.Unique());
+        head = nullptr;
+        assert(destroyed == 3);
+    }
+
+    // Test Type stays usable from static destructors after main returns
+    {
+        struct Logger {
+            ~Logger() {
+                auto p = Ptr<std::pair<int, int>>::Make();
+                if (p.Type() != "std::pair<int, int>") std::abort();
+            }
+        };
+        static Logger logger;
+        assert((Ptr<std::pair<int, int>>::Make().Type() == "std::pair<int, int>"));
+    }
+
+    // Test comparisons across related types, raw pointers and null
+    {
+        struct Base { virtual ~Base() {} };
+        struct Derived : Base {};
+        const auto derived = Ptr<Derived>::Make();
+        const Ptr<Base> base = derived.Cast<Base>();
+        const auto other = Ptr<Derived>::Make();
+        Base* raw = &*base;
+
+        static_assert(noexcept(base == derived) && noexcept(base <=> raw));
+        assert(base == derived && derived == base);
+        assert(base == raw && raw == base);
+        assert(derived != other && other != raw);
+        assert((derived < other) == std::less<Derived*>()(&*derived, &*other));
+        assert((derived <=> other) == (other > derived ? std::strong_ordering::less : std::strong_ordering::greater));
+        assert(Ptr<Base>() == nullptr && nullptr == Ptr<Base>());
+        assert(derived > nullptr);
+    }
+
+    // Test Ptr keys in hashed and ordered containers, looked up by raw pointer
+    {
+        std::vector<Ptr<int>> owned;
+        std::unordered_set<Ptr<int>> hashed;
+        std::unordered_map<Ptr<int>, int, PtrHash, PtrEqual> lookup;
+        std::set<Ptr<int>, PtrLess> ordered;
+        for (int i = 0; i < 10; ++i) {
+            owned.push_back(Ptr<int>::Make(i));
+            hashed.insert(owned.back());
+            lookup.emplace(owned.back(), i);
+            ordered.insert(owned.back());
+        }
+        assert(std::hash<Ptr<int>>()(owned[3]) == PtrHash()(&*owned[3]));
+        assert(hashed.count(owned[3]) == 1);
+
+        size_t before = allocationCount;
+        int* raw = &*owned[7];
+        assert(owned[7].Count() == 4);
+        assert(lookup.find(raw)->second == 7);
+        assert(ordered.find(raw) != ordered.end());
+        assert(*ordered.lower_bound(raw) == raw);
+        assert(lookup.find(static_cast<int*>(nullptr)) == lookup.end());
+        assert(owned[7].Count() == 4);
+        assert(allocationCount == before);
+
+        auto array = Ptr<int[]>::Make(3);
+        std::unordered_map<Ptr<int[]>, int, PtrHash, PtrEqual> arrays{{array, 1}};
+        assert(arrays.find(array.data())->second == 1);
+    }
+
     std::cout << "All tests passed!" << std::endl;
 }
 
+void testWeakPtrFunction() {
+    // Test Lock and Expired follow the strong references
+    {
+        WeakPtr<int> weak;
+        assert(weak.Expired());
+        assert(!weak.Lock());
+
+        auto p = Ptr<int>::Make(5);
+        weak = p;
+        assert(!weak.Expired());
+        assert(weak.Count() == 1);
+        {
+            auto locked = weak.Lock();
+            assert(locked && *locked == 5);
+            assert(p.Count() == 2);
+        }
+        p = nullptr;
+        assert(weak.Expired());
+        assert(!weak.Lock());
+    }
+
+    // Test the object is destroyed before the block is released
+    {
+        static int destroyed = 0;
+        struct Tracked { ~Tracked() { ++destroyed; } };
+        auto p = Ptr<Tracked>::Make();
+        WeakPtr<Tracked> weak1(p);
+        WeakPtr<Tracked> weak2 = weak1;
+        WeakPtr<Tracked> weak3 = std::move(weak2);
+        assert(weak2.Expired());
+        p.free();
+        assert(destroyed == 1);
+        assert(weak1.Expired() && weak3.Expired());
+    }
+
+    // Test weak back-references break ownership cycles
+    {
+        static int destroyed = 0;
+        struct Node {
+            Ptr<Node> child;
+            WeakPtr<Node> parent;
+            ~Node() { ++destroyed; }
+        };
+        {
+            auto root = Ptr<Node>::Make();
+            root->child = Ptr<Node>::Make();
+            root->child->parent = root;
+            assert(root.Unique());
+            assert(root->child->parent.Lock() == root);
+        }
+        assert(destroyed == 2);
+    }
+
+    std::cout << "Weak tests passed!" << std::endl;
+}
+
+// Opts Widget into intrusive counting for plain Ptr<Widget>
+struct Widget;
+template <>
+struct PtrTraits<Widget> {
+    using CountPolicy = Intrusive<>;
+};
+
+struct Widget : RefCounted {
+    int value;
+    explicit Widget(int value) : value(value) {}
+};
+
+void testIntrusivePtrFunction() {
+    // Test intrusive Ptrs are one pointer wide and count in the object
+    {
+        static_assert(sizeof(Ptr<Widget>) == sizeof(Widget*));
+        static_assert(sizeof(Ptr<int>) == 2 * sizeof(int*));
+
+        size_t before = allocationCount;
+        auto p1 = Ptr<Widget>::Make(3);
+        assert(allocationCount - before == 1);
+        assert(p1.Unique());
+        auto p2 = p1;
+        assert(p1.Count() == 2);
+        assert(p2->value == 3);
+        auto p3 = std::move(p2);
+        assert(!p2);
+        assert(p3.Count() == 2);
+        p1 = nullptr;
+        assert(p3.Unique());
+    }
+
+    // Test Cast shares the count of a polymorphic intrusive object
+    {
+        static int destroyed = 0;
+        struct Shape : RefCounted { virtual ~Shape() { ++destroyed; } };
+        struct Circle : Shape {};
+
+        {
+            auto circle = Ptr<Circle, Intrusive<>>::Make();
+            Ptr<Shape, Intrusive<>> shape = circle.Cast<Shape>();
+            assert(circle.Count() == 2);
+            auto back = shape.Cast<Circle>();
+            assert(back == circle);
+            assert(shape.Count() == 3);
+            circle = nullptr;
+            back = nullptr;
+            assert(shape.Unique());
+        }
+        assert(destroyed == 1);
+    }
+
+    // Test const Ptrs to an intrusive type share its count
+    {
+        static_assert(sizeof(Ptr<const Widget>) == sizeof(Widget*));
+        auto p = Ptr<Widget>::Make(5);
+        Ptr<const Widget> c = p.ConstCast<const Widget>();
+        assert(p.Count() == 2);
+        assert(c->value == 5);
+        auto made = Ptr<const Widget>::Make(6);
+        assert(made.Unique() && made->value == 6);
+    }
+
+    // Test copying an object does not copy its count
+    {
+        auto p = Ptr<Widget>::Make(4);
+        auto q = p;
+        auto copy = Ptr<Widget>::Make(*p);
+        assert(copy.Unique());
+        assert(copy->value == 4);
+    }
+
+    // Test the atomic intrusive policy across threads
+    {
+        auto shared = Ptr<Widget, Intrusive<AtomicCount>>::Make(9);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&shared] {
+                for (int i = 0; i < 10000; ++i) {
+                    auto copy = shared;
+                    assert(copy->value == 9);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        assert(shared.Unique());
+    }
+
+    std::cout << "Intrusive tests passed!" << std::endl;
+}
+
+void testAllocatorFunction() {
+    static int destroyed = 0;
+    struct Tracked {
+        int value;
+        explicit Tracked(int value) : value(value) {}
+        ~Tracked() { ++destroyed; }
+    };
+
+    // Test pooled blocks are recycled without touching the heap
+    {
+        Ptr<Tracked>::AllocateWith<Pool>(0);  // warm this thread's cache
+        size_t before = allocationCount;
+        for (int i = 0; i < 1000; ++i) {
+            auto p = Ptr<Tracked>::AllocateWith<Pool>(i);
+            auto q = p;
+            assert(q->value == i);
+            assert(p.Count() == 2);
+        }
+        assert(allocationCount == before);
+        assert(destroyed == 1001);
+    }
+
+    // Test pooled blocks and AtomicPtr nodes outlive this thread's cache, as
+    // when held by statics destroyed after main returns
+    {
+        struct Holder {
+            Ptr<Tracked> pooled = Ptr<Tracked>::AllocateWith<Pool>(7);
+            AtomicPtr<int> slot{SharedPtr<int>::Make(1)};
+            ~Holder() {
+                const Tracked* released = &*pooled;
+                pooled = nullptr;
+                auto again = Ptr<Tracked>::AllocateWith<Pool>(8);
+                assert(&*again == released);
+                slot.Store(SharedPtr<int>::Make(2));
+            }
+        };
+        static Holder holder;
+        assert(holder.pooled->value == 7);
+    }
+
+    // Test pooled blocks released on another thread and weak references
+    {
+        std::vector<Ptr<Tracked, AtomicCount>> made;
+        for (int i = 0; i < 500; ++i)
+            made.push_back(Ptr<Tracked, AtomicCount>::AllocateWith<Pool>(i));
+        WeakPtr<Tracked, AtomicCount> weak(made.front());
+        std::thread releaser([&made] { made.clear(); });
+        releaser.join();
+        assert(weak.Expired());
+        assert(destroyed == 1501);
+    }
+
+    // Test arena blocks are reclaimed in bulk
+    {
+        Arena arena(256);
+        {
+            auto p = Ptr<Tracked>::AllocateWith(arena, 1);
+            auto q = Ptr<std::string>::AllocateWith(arena, 100, 'x');
+            assert(arena.Live() == 2);
+            assert(q->size() == 100);
+            Ptr<Tracked> copy = p;
+            p = nullptr;
+            assert(destroyed == 1501);
+            try {
+                arena.Reset();
+                assert(false);
+            } catch (const ArenaInUse&) {}
+        }
+        assert(destroyed == 1502);
+        assert(arena.Live() == 0);
+        arena.Reset();
+
+        size_t before = allocationCount;
+        auto p = Ptr<Tracked>::AllocateWith(arena, 2);
+        assert(allocationCount == before);
+        assert(p->value == 2);
+    }
+
+    // Test a throwing constructor hands the memory back
+    {
+        struct Throws { Throws() { throw 1; } };
+        Arena arena;
+        try {
+            Ptr<Throws>::AllocateWith(arena);
+            assert(false);
+        } catch (int) {}
+        assert(arena.Live() == 0);
+    }
+
+    std::cout << "Allocator tests passed!" << std::endl;
+}
+
+struct Shape {
+    int id = 0;
+    virtual ~Shape() {}
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & BOOST_SERIALIZATION_NVP(id);
+    }
+};
+
+struct Circle : Shape {
+    double radius = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & boost::serialization::base_object<Shape>(*this);
+        ar & BOOST_SERIALIZATION_NVP(radius);
+    }
+};
+
+BOOST_CLASS_EXPORT(Circle)
+
+struct GraphNode {
+    int value = 0;
+    std::vector<Ptr<GraphNode>> edges;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & BOOST_SERIALIZATION_NVP(value);
+        ar & BOOST_SERIALIZATION_NVP(edges);
+    }
+};
+
+// Counted in the object, loaded as a plain intrusive Ptr
+struct Gadget : RefCounted {
+    int id = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & BOOST_SERIALIZATION_NVP(id);
+    }
+};
+
+struct Scene {
+    Ptr<Circle> circle;
+    Ptr<Shape> shape;
+    Ptr<Circle> alias;
+    Ptr<Shape> empty;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version) {
+        ar & BOOST_SERIALIZATION_NVP(circle);
+        ar & BOOST_SERIALIZATION_NVP(shape);
+        ar & BOOST_SERIALIZATION_NVP(alias);
+        ar & BOOST_SERIALIZATION_NVP(empty);
+    }
+};
+
+void testSerializationFunction() {
+    // Test aliases of a polymorphic object load as one shared object
+    {
+        std::stringstream stream;
+        {
+            Scene scene;
+            scene.circle = Ptr<Circle>::Make();
+            scene.circle->id = 7;
+            scene.circle->radius = 1.5;
+            scene.shape = scene.circle.Cast<Shape>();
+            scene.alias = scene.circle;
+            boost::archive::text_oarchive oa(stream);
+            oa << scene;
+        }
+
+        Scene loaded;
+        {
+            boost::archive::text_iarchive ia(stream);
+            ia >> loaded;
+        }
+        assert(loaded.circle && loaded.circle->radius == 1.5);
+        assert(loaded.circle == loaded.alias);
+        assert(loaded.shape.Cast<Circle>() == loaded.circle);
+        assert(loaded.shape->id == 7);
+        assert(loaded.shape.Type().find("Circle") != std::string::npos);
+        assert(loaded.circle.Count() == 3);
+        assert(!loaded.empty);
+
+        WeakPtr<Circle> weak(loaded.circle);
+        loaded = Scene();
+        assert(weak.Expired());
+    }
+
+    // Test a shared graph round-trips through a binary archive
+    {
+        std::stringstream stream;
+        {
+            std::vector<Ptr<GraphNode>> nodes;
+            for (int i = 0; i < 100; ++i) {
+                auto node = Ptr<GraphNode>::Make();
+                node->value = i;
+                if (i > 0) node->edges.push_back(nodes[i - 1]);
+                if (i > 1) node->edges.push_back(nodes[i / 2]);
+                nodes.push_back(node);
+            }
+            boost::archive::binary_oarchive oa(stream);
+            oa << nodes;
+        }
+
+        std::vector<Ptr<GraphNode>> nodes;
+        {
+            boost::archive::binary_iarchive ia(stream);
+            ia >> nodes;
+        }
+        assert(nodes.size() == 100);
+        for (int i = 0; i < 100; ++i) {
+            assert(nodes[i]->value == i);
+            if (i > 0) assert(nodes[i]->edges[0] == nodes[i - 1]);
+            if (i > 1) assert(nodes[i]->edges[1] == nodes[i / 2]);
+        }
+        // Held by the vector, by its successor and by the nodes halving to it
+        assert(nodes[99].Count() == 1);
+        assert(nodes[98].Count() == 2);
+        assert(nodes[10].Count() == 4);
+    }
+
+    // Test an alias still loads after the first Ptr to its object is dropped
+    {
+        std::stringstream stream;
+        {
+            auto circle = Ptr<Circle>::Make();
+            circle->radius = 2.5;
+            Ptr<Shape> shape = circle.Cast<Shape>();
+            boost::archive::text_oarchive oa(stream);
+            oa << circle << shape;
+        }
+
+        Ptr<Shape> shape;
+        {
+            boost::archive::text_iarchive ia(stream);
+            Ptr<Circle> circle;
+            ia >> circle;
+            circle = nullptr;
+            ia >> shape;
+            assert(shape.Cast<Circle>()->radius == 2.5);
+        }
+        assert(shape.Unique());
+    }
+
+    std::cout << "Serialization tests passed!" << std::endl;
+}
+
+void testReclaimerFunction() {
+    static std::vector<int> destroyed;
+    struct Tracked {
+        int id;
+        Ptr<Tracked> child;
+        explicit Tracked(int id) : id(id) {}
+        ~Tracked() { destroyed.push_back(id); }
+    };
+
+    // Test the last release queues the object instead of destroying it
+    {
+        auto before = Reclaimer::GetStats();
+        auto p = Ptr<Tracked>::MakeDeferred(1);
+        WeakPtr<Tracked> weak(p);
+        p = nullptr;
+        assert(destroyed.empty());
+        assert(weak.Expired());
+        assert(Reclaimer::GetStats().depth == before.depth + 1);
+
+        assert(Reclaimer::Collect() == 1);
+        assert(destroyed == std::vector<int>{1});
+        auto after = Reclaimer::GetStats();
+        assert(after.depth == before.depth);
+        assert(after.deferred == before.deferred + 1);
+        assert(after.reclaimed == before.reclaimed + 1);
+        assert(after.max_latency_ns > 0);
+    }
+
+    // Test bounded batches drain oldest first
+    {
+        destroyed.clear();
+        for (int id = 0; id < 10; ++id) Ptr<Tracked>::MakeDeferred(id);
+        assert(Reclaimer::Collect(3) == 3);
+        assert((destroyed == std::vector<int>{0, 1, 2}));
+        assert(Reclaimer::GetStats().depth == 7);
+        assert(Reclaimer::Collect(100) == 7);
+        assert(destroyed.size() == 10 && destroyed.back() == 9);
+    }
+
+    // Test objects released by a reclaimed destructor are queued in turn
+    {
+        destroyed.clear();
+        {
+            auto parent = Ptr<Tracked>::MakeDeferred(1);
+            parent->child = Ptr<Tracked>::MakeDeferred(2);
+        }
+        assert(Reclaimer::Collect() == 1);
+        assert(Reclaimer::Collect() == 1);
+        assert((destroyed == std::vector<int>{1, 2}));
+    }
+
+    // Test a reclaimed destructor may collect at a safe point of its own
+    {
+        static size_t nested = 0;
+        struct Collecting {
+            ~Collecting() { nested = Reclaimer::Collect(); }
+        };
+        destroyed.clear();
+        Ptr<Collecting>::MakeDeferred();
+        Ptr<Tracked>::MakeDeferred(3);
+        assert(Reclaimer::Collect(1) == 1);
+        assert(nested == 1);
+        assert((destroyed == std::vector<int>{3}));
+    }
+
+    // Test the background thread reclaims objects released on other threads
+    {
+        static std::atomic<int> reclaimed{0};
+        struct Shared { ~Shared() { ++reclaimed; } };
+
+        Reclaimer::Start(std::chrono::microseconds(100));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 1000; ++i) {
+                    auto p = SharedPtr<Shared>::MakeDeferred();
+                    auto copy = p;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        Reclaimer::Stop();
+        assert(reclaimed == 4000);
+        assert(Reclaimer::GetStats().depth == 0);
+    }
+
+    // Test unshared local-count objects handed to the background thread
+    {
+        static std::atomic<int> reclaimed{0};
+        struct Local { ~Local() { ++reclaimed; } };
+
+        auto before = Reclaimer::GetStats();
+        Reclaimer::Start(std::chrono::microseconds(10));
+        for (int i = 0; i < 10000; ++i) {
+            Ptr<Local>::MakeDeferred();
+            auto stats = Reclaimer::GetStats();
+            assert(stats.depth <= 10000 && stats.reclaimed <= stats.deferred);
+        }
+        Reclaimer::Stop();
+        assert(reclaimed == 10000);
+        assert(Reclaimer::GetStats().reclaimed == before.reclaimed + 10000);
+    }
+
+    std::cout << "Reclaimer tests passed!" << std::endl;
+}
+
+void testArrayPtrFunction() {
+    // Test Make value-initializes the elements in one allocation
+    {
+        size_t before = allocationCount;
+        auto values = Ptr<int[]>::Make(100);
+        assert(allocationCount - before == 1);
+        assert(values.size() == 100);
+        assert(values.Unique());
+        for (int v : values) assert(v == 0);
+        values[3] = 7;
+        auto copy = values;
+        assert(copy[3] == 7);
+        assert(values.Count() == 2);
+    }
+
+    // Test aligned storage and span access
+    {
+        auto floats = Ptr<float[]>::MakeAligned<64>(1000);
+        assert(reinterpret_cast<uintptr_t>(floats.data()) % 64 == 0);
+        assert(floats.Alignment() == 64);
+        std::span<float> span = floats.Span();
+        assert(span.size() == 1000);
+        for (size_t i = 0; i < span.size(); ++i) span[i] = float(i);
+        float sum = 0;
+        for (float f : floats) sum += f;
+        assert(sum == 499500.0f);
+
+        auto wide = Ptr<double[]>::MakeAlignedUninitialized<128>(3);
+        assert(reinterpret_cast<uintptr_t>(wide.data()) % 128 == 0);
+        assert(Ptr<char[]>::MakeUninitialized(5).size() == 5);
+        assert(Ptr<int[]>::Make(0).size() == 0);
+        assert(Ptr<int[]>().size() == 0);
+    }
+
+    // Test element destructors run once and a throwing constructor cleans up
+    {
+        static int constructed = 0, destroyed = 0;
+        struct Element {
+            Element() {
+                if (constructed == 13) throw 1;
+                ++constructed;
+            }
+            ~Element() { ++destroyed; }
+        };
+
+        {
+            auto elements = Ptr<Element[]>::Make(10);
+            auto shared = elements;
+            elements = nullptr;
+            assert(destroyed == 0);
+        }
+        assert(constructed == 10 && destroyed == 10);
+
+        try {
+            Ptr<Element[]>::Make(10);
+            assert(false);
+        } catch (int) {}
+        assert(constructed == 13 && destroyed == 13);
+    }
+
+    std::cout << "Array tests passed!" << std::endl;
+}
+
+void testSharedPtrFunction() {
+    const int threadCount = 8;
+    const int iterations = 100000;
+
+    // Test concurrent copies and releases keep the count exact
+    {
+        auto shared = SharedPtr<int>::Make(7);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&shared] {
+                for (int i = 0; i < iterations; ++i) {
+                    SharedPtr<int> copy = shared;
+                    SharedPtr<int> moved = std::move(copy);
+                    assert(*moved == 7);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        assert(shared.Unique());
+    }
+
+    // Test the object is destroyed exactly once by whichever thread lets go last
+    {
+        static std::atomic<int> destroyed{0};
+        struct Tracked {
+            int value = 0;
+            ~Tracked() { ++destroyed; }
+        };
+
+        for (int round = 0; round < 100; ++round) {
+            auto shared = SharedPtr<Tracked>::Make();
+            shared->value = round;
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([copy = shared, round]() mutable {
+                    assert(copy->value == round);
+                    copy = nullptr;
+                });
+            }
+            shared = nullptr;
+            for (auto& thread : threads) thread.join();
+            assert(destroyed == round + 1);
+        }
+    }
+
+    // Test Lock racing with the last release never revives the object
+    {
+        for (int round = 0; round < 1000; ++round) {
+            auto shared = SharedPtr<int>::Make(round);
+            SharedWeakPtr<int> weak(shared);
+            std::thread locker([weak, round] {
+                auto locked = weak.Lock();
+                assert(!locked || *locked == round);
+            });
+            shared = nullptr;
+            locker.join();
+            assert(weak.Expired());
+        }
+    }
+
+    // Test AtomicPtr operations on one thread
+    {
+        AtomicPtr<int> slot;
+        assert(slot.IsLockFree());
+        assert(!slot.Load());
+
+        auto first = SharedPtr<int>::Make(1);
+        slot.Store(first);
+        assert(slot.Load() == first);
+        assert(first.Count() == 2);
+
+        auto old = slot.Exchange(SharedPtr<int>::Make(2));
+        assert(old == first);
+        assert(first.Count() == 2);
+        assert(*slot.Load() == 2);
+
+        SharedPtr<int> expected = first;
+        assert(!slot.CompareExchange(expected, SharedPtr<int>::Make(3)));
+        assert(*expected == 2);
+        assert(slot.CompareExchange(expected, SharedPtr<int>::Make(4)));
+        assert(*slot.Load() == 4);
+        assert(expected.Unique());
+
+        slot.Store(nullptr);
+        assert(!slot.Load());
+        SharedPtr<int> none;
+        assert(slot.CompareExchange(none, first));
+        assert(slot.Load() == first);
+    }
+
+    // Test readers never see a freed snapshot while a writer publishes
+    {
+        static std::atomic<int> alive{0};
+        struct Snapshot {
+            int version;
+            explicit Snapshot(int version) : version(version) { ++alive; }
+            ~Snapshot() { version = -1; --alive; }
+        };
+
+        {
+            AtomicPtr<Snapshot> slot(SharedPtr<Snapshot>::Make(0));
+            std::atomic<bool> done{false};
+            std::vector<std::thread> readers;
+            for (int t = 0; t < threadCount; ++t) {
+                readers.emplace_back([&] {
+                    int last = 0;
+                    while (!done) {
+                        auto snapshot = slot.Load();
+                        assert(snapshot && snapshot->version >= last);
+                        last = snapshot->version;
+                    }
+                });
+            }
+            for (int version = 1; version <= 20000; ++version)
+                slot.Store(SharedPtr<Snapshot>::Make(version));
+            done = true;
+            for (auto& reader : readers) reader.join();
+            assert(slot.Load()->version == 20000);
+            assert(alive == 1);
+        }
+        assert(alive == 0);
+    }
+
+    // Test concurrent CompareExchange loops lose no updates
+    {
+        AtomicPtr<int> counter(SharedPtr<int>::Make(0));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&counter] {
+                for (int i = 0; i < 2000; ++i) {
+                    auto current = counter.Load();
+                    while (!counter.CompareExchange(current, SharedPtr<int>::Make(*current + 1))) {}
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        assert(*counter.Load() == threadCount * 2000);
+        assert(counter.Load().Count() == 2);
+    }
+
+    // Test Cast keeps the atomic policy and shares the count
+    {
+        class Base { public: virtual ~Base() {} };
+        class Derived : public Base {};
+        auto derived = SharedPtr<Derived>::Make();
+        SharedPtr<Base> base = derived.Cast<Base>();
+        assert(base.Count() == 2);
+    }
+
+    std::cout << "Shared tests passed!" << std::endl;
+}
+
+void testInstrumentationFunction() {
+    struct Sample { double values[4]; };
+    struct Base : RefCounted { virtual ~Base() = default; };
+    struct Derived : Base { int extra[8]; };
+
+    if constexpr (!PtrStats::enabled) {
+        // Test nothing is recorded without PTR_INSTRUMENT
+        auto p = Ptr<Sample>::Make();
+        auto q = p;
+        assert(PtrStats::Snapshot().empty());
+        assert(PtrStats::Of<Sample>().makes == 0);
+        std::cout << "Instrumentation tests passed!" << std::endl;
+        return;
+    }
+
+    // Test live objects, makes, copies, moves and memory per type
+    {
+        auto a = Ptr<Sample>::Make();
+        auto b = Ptr<Sample>::MakeDeferred();
+        auto c = Ptr<Sample>::AllocateWith<Pool>();
+        Ptr<Sample> copy = a;
+        copy = b;
+        Ptr<Sample> moved = std::move(copy);
+        moved = std::move(c);
+        Ptr<Sample> empty;
+        Ptr<Sample> emptyCopy = empty;
+
+        auto stats = PtrStats::Of<Sample>();
+        assert(stats.type == a.Type());
+        assert(stats.live == 3);
+        assert(stats.makes == 3);
+        assert(stats.copies == 2);
+        assert(stats.moves == 2);
+        assert(stats.live_bytes == 3 * sizeof(Sample));
+        assert(stats.peak_bytes == 3 * sizeof(Sample));
+
+        a = nullptr;
+        moved = nullptr;
+        stats = PtrStats::Of<Sample>();
+        assert(stats.live == 1);
+        assert(stats.live_bytes == sizeof(Sample));
+        assert(stats.peak_bytes == 3 * sizeof(Sample));
+    }
+    Reclaimer::Collect();
+    assert(PtrStats::Of<Sample>().live == 0);
+
+    // Test arrays count bytes per element and intrusive objects count under
+    // the type they were made as
+    {
+        auto floats = Ptr<float[]>::Make(100);
+        assert(PtrStats::Of<float[]>().live_bytes == 100 * sizeof(float));
+
+        Ptr<Base, Intrusive<>> base = Ptr<Derived, Intrusive<>>::Make().Cast<Base>();
+        assert(PtrStats::Of<Derived>().live == 1);
+        assert(PtrStats::Of<Derived>().live_bytes == sizeof(Derived));
+        base = nullptr;
+        assert(PtrStats::Of<Derived>().live == 0);
+        assert(PtrStats::Of<Derived>().live_bytes == 0);
+        assert(PtrStats::Of<Base>().live == 0);
+    }
+    assert(PtrStats::Of<float[]>().live == 0);
+
+    // Test intrusive objects loaded from an archive are counted like made ones
+    {
+        std::stringstream stream;
+        {
+            auto gadget = Ptr<Gadget, Intrusive<>>::Make();
+            boost::archive::text_oarchive oa(stream);
+            oa << gadget;
+        }
+        auto before = PtrStats::Of<Gadget>();
+        {
+            Ptr<Gadget, Intrusive<>> loaded;
+            {
+                boost::archive::text_iarchive ia(stream);
+                ia >> loaded;
+            }
+            auto stats = PtrStats::Of<Gadget>();
+            assert(stats.live == before.live + 1);
+            assert(stats.makes == before.makes + 1);
+            assert(stats.live_bytes == before.live_bytes + sizeof(Gadget));
+        }
+        auto after = PtrStats::Of<Gadget>();
+        assert(after.live == before.live);
+        assert(after.live_bytes == before.live_bytes);
+    }
+
+    // Test the leak report names each type with live objects
+    // beyond those held by statics of earlier tests
+    std::ostringstream baseline;
+    uint64_t held = PtrStats::ReportLeaks(baseline);
+    {
+        auto kept = Ptr<Sample>::Make();
+        std::ostringstream report;
+        assert(PtrStats::ReportLeaks(report) == held + 1);
+        assert(report.str().find(kept.Type()) != std::string::npos);
+    }
+    std::ostringstream clean;
+    assert(PtrStats::ReportLeaks(clean) == held);
+    assert(clean.str() == baseline.str());
+
+    // Test the report at exit, in a child whose stderr goes to a pipe
+    {
+        int fds[2];
+        assert(pipe(fds) == 0);
+        pid_t child = fork();
+        assert(child >= 0);
+        if (child == 0) {
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[0]);
+            static auto kept = Ptr<Sample>::Make();
+            assert(!kept.Type().empty());
+            PtrStats::ReportLeaksAtExit();
+            std::exit(0);
+        }
+        close(fds[1]);
+        std::string report;
+        char buffer[256];
+        for (ssize_t n; (n = read(fds[0], buffer, sizeof buffer)) > 0;) report.append(buffer, n);
+        close(fds[0]);
+        int status = 0;
+        waitpid(child, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        assert(report.find("Ptr leak: 1 live " + Ptr<Sample>::Make().Type()) != std::string::npos);
+    }
+
+    std::cout << "Instrumentation tests passed!" << std::endl;
+}
+
 int main() {
     testPtrFunction();
+    testWeakPtrFunction();
+    testIntrusivePtrFunction();
+    testAllocatorFunction();
+    testSerializationFunction();
+    testReclaimerFunction();
+    testArrayPtrFunction();
+    testSharedPtrFunction();
+    testInstrumentationFunction();
     return 0;
 }
\ No newline at end of file
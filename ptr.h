@@ -7,100 +7,1479 @@
     #include <cxxabi.h>
     #include <memory>
     #include <sstream>
+    #include <new>
+    #include <atomic>
+    #include <mutex>
+    #include <vector>
+    #include <cassert>
+    #include <type_traits>
+    #include <algorithm>
+    #include <cstdlib>
+    #include <typeindex>
+    #include <unordered_map>
+    #include <chrono>
+    #include <condition_variable>
+    #include <thread>
+    #include <span>
+    #include <utility>
+    #include <compare>
+    #include <functional>
 
     #include <boost/serialization/serialization.hpp> 
     #include <boost/serialization/nvp.hpp> 
     #include <boost/serialization/split_member.hpp>
+    #include <boost/serialization/level.hpp>
+    #include <boost/serialization/tracking.hpp>
 
     using namespace std;
 
+    // How operator* and operator-> treat a null Ptr, fixed at compile time by
+    // defining PTR_NULL_CHECK before including this header:
+    //   PTR_CHECK_THROW   throw UninitializedPointer (default)
+    //   PTR_CHECK_ASSERT  assert, so only debug builds pay for the check
+    //   PTR_CHECK_NONE    no check; dereferencing null is undefined
+    // Every translation unit in a program must use the same setting.
+    #define PTR_CHECK_NONE 0
+    #define PTR_CHECK_ASSERT 1
+    #define PTR_CHECK_THROW 2
+
+    #ifndef PTR_NULL_CHECK
+    #define PTR_NULL_CHECK PTR_CHECK_THROW
+    #endif
+
     class UninitializedPointer : public exception {
     public:
         const char* what() const noexcept override {
             return "Tried to access uninitialized pointer object.";
         }
-    };
+    };
+
+    class PointerAlreadyInitialized : public exception {
+    public:
+        const char* what() const noexcept override {
+            return "Tried to reinitialize a pointer that already exists.";
+        }
+    };
+
+    namespace ptr_detail {
+
+        // Kept out of line so the check inlined into each dereference is a
+        // single compare and branch
+        [[noreturn, gnu::cold, gnu::noinline]] inline void ThrowUninitialized() {
+            throw UninitializedPointer();
+        }
+
+        inline constexpr bool checked_dereference = PTR_NULL_CHECK == PTR_CHECK_THROW;
+
+        inline void CheckNotNull([[maybe_unused]] const void* ptr) noexcept(!checked_dereference) {
+            #if PTR_NULL_CHECK == PTR_CHECK_THROW
+            if (!ptr) [[unlikely]] ThrowUninitialized();
+            #elif PTR_NULL_CHECK == PTR_CHECK_ASSERT
+            assert(ptr && "Tried to access uninitialized pointer object.");
+            #endif
+        }
+
+        inline const string null_name = "Null";
+
+        inline string Demangle(const std::type_info& type) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+            string name = demangled ? demangled : type.name();
+            std::free(demangled);
+            return name;
+        }
+
+        // Readable name of a type, demangled once per type for the whole
+        // program. Names are published in a fixed table that lookups probe
+        // without locking; only the first lookup of a type takes the lock.
+        // Nothing here is ever destroyed, so names stay usable from static
+        // destructors and exit handlers.
+        inline const string& DemangledName(const std::type_info& type) {
+            struct Entry {
+                const std::type_info* type;
+                string name;
+            };
+            constexpr size_t slots = 1024;
+            static std::atomic<Entry*> table[slots];
+
+            size_t start = (reinterpret_cast<uintptr_t>(&type) >> 3) % slots;
+            for (size_t i = 0; i < slots; ++i) {
+                Entry* entry = table[(start + i) % slots].load(std::memory_order_acquire);
+                if (!entry) break;
+                if (entry->type == &type) return entry->name;
+            }
+
+            static std::mutex mutex;
+            static auto* overflow = new std::unordered_map<const std::type_info*, string>;
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < slots; ++i) {
+                auto& slot = table[(start + i) % slots];
+                Entry* entry = slot.load(std::memory_order_relaxed);
+                if (entry && entry->type == &type) return entry->name;
+                if (entry) continue;
+
+                entry = new Entry{&type, Demangle(type)};
+                slot.store(entry, std::memory_order_release);
+                return entry->name;
+            }
+
+            // Table full: fall back to a locked map
+            auto it = overflow->find(&type);
+            if (it == overflow->end()) it = overflow->emplace(&type, Demangle(type)).first;
+            return it->second;
+        }
+
+    }
+
+    // Opt-in per-type counters, enabled by defining PTR_INSTRUMENT before
+    // including this header. Without it every hook below is discarded at
+    // compile time and Ptr costs exactly what it did before.
+    #ifdef PTR_INSTRUMENT
+    #define PTR_INSTRUMENT_ENABLED true
+    #else
+    #define PTR_INSTRUMENT_ENABLED false
+    #endif
+
+    namespace ptr_detail {
+
+        inline constexpr bool instrumented = PTR_INSTRUMENT_ENABLED;
+
+        // Counters for one type, created on first use and never freed so they
+        // can still be read by exit handlers. Kept in malloc'd memory so that
+        // turning instrumentation on does not show up in operator new counts.
+        struct TypeCounters {
+            const std::type_info* type;
+            size_t object_size;
+            TypeCounters* next;
+            std::atomic<uint64_t> live{0};
+            std::atomic<uint64_t> makes{0};
+            std::atomic<uint64_t> copies{0};
+            std::atomic<uint64_t> moves{0};
+            std::atomic<uint64_t> live_bytes{0};
+            std::atomic<uint64_t> peak_bytes{0};
+
+            TypeCounters(const std::type_info& type, size_t object_size, TypeCounters* next)
+                : type(&type), object_size(object_size), next(next) {}
+        };
+
+        inline std::atomic<TypeCounters*> type_counters{nullptr};
+
+        inline TypeCounters* FindCounters(const std::type_info& type) noexcept {
+            for (TypeCounters* c = type_counters.load(std::memory_order_acquire); c; c = c->next)
+                if (*c->type == type) return c;
+            return nullptr;
+        }
+
+        inline TypeCounters* RegisterCounters(const std::type_info& type, size_t object_size) {
+            static std::mutex mutex;
+            std::lock_guard<std::mutex> lock(mutex);
+            if (TypeCounters* found = FindCounters(type)) return found;
+            void* memory = std::malloc(sizeof(TypeCounters));
+            if (!memory) throw std::bad_alloc();
+            auto* counters = ::new (memory) TypeCounters(type, object_size, type_counters.load(std::memory_order_relaxed));
+            type_counters.store(counters, std::memory_order_release);
+            return counters;
+        }
+
+        // Counters of T, looked up once per type. Arrays count bytes per element.
+        template <typename T>
+        TypeCounters& CountersFor() {
+            static TypeCounters* counters = RegisterCounters(typeid(T), sizeof(std::remove_extent_t<T>));
+            return *counters;
+        }
+
+        // Counters of the object's dynamic type, used for intrusive objects,
+        // which may be released through a base Ptr. A derived type first seen
+        // this way, as when an archive loads it, has no known size and counts
+        // no bytes; object_size never changes, so makes and destroys agree.
+        template <typename T>
+        TypeCounters& CountersOf(T* object) {
+            if constexpr (std::is_polymorphic_v<T>) {
+                const std::type_info& type = typeid(*object);
+                if (type != typeid(T)) {
+                    if (TypeCounters* found = FindCounters(type)) return *found;
+                    return *RegisterCounters(type, 0);
+                }
+            }
+            return CountersFor<T>();
+        }
+
+        inline void CountMake(TypeCounters& counters, size_t bytes) noexcept {
+            counters.makes.fetch_add(1, std::memory_order_relaxed);
+            counters.live.fetch_add(1, std::memory_order_relaxed);
+            uint64_t now = counters.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+            while (now > peak && !counters.peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+        }
+
+        inline void CountDestroy(TypeCounters& counters, size_t bytes) noexcept {
+            counters.live.fetch_sub(1, std::memory_order_relaxed);
+            counters.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        template <typename T>
+        void CountCopy() noexcept {
+            CountersFor<T>().copies.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template <typename T>
+        void CountMove() noexcept {
+            CountersFor<T>().moves.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    }
+
+    // Snapshot of one type's counters. Bytes are object bytes only, without
+    // control block or allocator overhead.
+    struct PtrTypeStats {
+        string type;
+        uint64_t live;
+        uint64_t makes;
+        uint64_t copies;
+        uint64_t moves;
+        uint64_t live_bytes;
+        uint64_t peak_bytes;
+    };
+
+    // Runtime view of the PTR_INSTRUMENT counters. Objects are counted under
+    // the type they were made as, copies and moves under the Ptr's own type.
+    // Without PTR_INSTRUMENT nothing is recorded and Snapshot is empty.
+    class PtrStats {
+    public:
+        static constexpr bool enabled = ptr_detail::instrumented;
+
+        // Every type seen so far
+        static std::vector<PtrTypeStats> Snapshot() {
+            std::vector<PtrTypeStats> stats;
+            for (auto* c = ptr_detail::type_counters.load(std::memory_order_acquire); c; c = c->next)
+                stats.push_back(Read(*c));
+            return stats;
+        }
+
+        // Counters of one type, zero if nothing of it has been seen
+        template <typename T>
+        static PtrTypeStats Of() {
+            if (const auto* c = ptr_detail::FindCounters(typeid(T))) return Read(*c);
+            return {ptr_detail::DemangledName(typeid(T)), 0, 0, 0, 0, 0, 0};
+        }
+
+        // Print one line per type with live objects; returns how many are live
+        static uint64_t ReportLeaks(std::ostream& out) {
+            uint64_t total = 0;
+            for (const auto& s : Snapshot()) {
+                if (s.live == 0) continue;
+                out << "Ptr leak: " << s.live << " live " << s.type
+                    << " (" << s.live_bytes << " bytes)" << endl;
+                total += s.live;
+            }
+            return total;
+        }
+
+        // Report to cerr whatever is still alive when the program exits.
+        // Objects owned by static Ptrs are destroyed after this runs and so
+        // show up as live.
+        static void ReportLeaksAtExit() {
+            static std::once_flag once;
+            std::call_once(once, [] {
+                std::atexit([] { ReportLeaks(std::cerr); });
+            });
+        }
+
+    private:
+
+        static PtrTypeStats Read(const ptr_detail::TypeCounters& c) {
+            return {
+                ptr_detail::DemangledName(*c.type),
+                c.live.load(std::memory_order_relaxed),
+                c.makes.load(std::memory_order_relaxed),
+                c.copies.load(std::memory_order_relaxed),
+                c.moves.load(std::memory_order_relaxed),
+                c.live_bytes.load(std::memory_order_relaxed),
+                c.peak_bytes.load(std::memory_order_relaxed),
+            };
+        }
+    };
+
+    class ArenaInUse : public exception {
+    public:
+        const char* what() const noexcept override {
+            return "Tried to reset an arena that still holds live objects.";
+        }
+    };
+
+    namespace ptr_detail {
+
+        // Shared header of every allocation that backs a Ptr. Each block type
+        // knows how to destroy its object and release its own memory. The
+        // object goes when count reaches zero; the block goes when weak does,
+        // with all strong references together holding one weak reference.
+        struct ControlBlock {
+            alignas(std::atomic_ref<uint32_t>::required_alignment) uint32_t count = 1;
+            alignas(std::atomic_ref<uint32_t>::required_alignment) uint32_t weak = 1;
+
+            virtual void Dispose() noexcept = 0;
+            virtual void Deallocate() noexcept = 0;
+
+            // Called by the last strong reference. Returns whether the caller
+            // still holds the strong side's weak reference; a block that hands
+            // itself off along with it returns false and must not be touched.
+            virtual bool Expire() noexcept {
+                Dispose();
+                return true;
+            }
+
+        protected:
+            ~ControlBlock() = default;
+        };
+
+        // Object and count in one allocation, laid out after the header with
+        // the object's own alignment. Where the memory comes from is left to
+        // the final block types below.
+        template <typename T>
+        struct InlineBlock : ControlBlock {
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            template <typename... Args>
+            explicit InlineBlock(Args&&... args) {
+                ::new (static_cast<void*>(storage)) T(std::forward<Args>(args)...);
+                if constexpr (instrumented) CountMake(CountersFor<T>(), sizeof(T));
+            }
+
+            T* Object() noexcept {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+
+            void Dispose() noexcept override {
+                if constexpr (instrumented) CountDestroy(CountersFor<T>(), sizeof(T));
+                Object()->~T();
+            }
+
+        protected:
+            ~InlineBlock() = default;
+        };
+
+        // Inline block allocated with new, as made by Ptr::Make
+        template <typename T>
+        struct MadeBlock final : InlineBlock<T> {
+            using InlineBlock<T>::InlineBlock;
+
+            void Deallocate() noexcept override {
+                delete this;
+            }
+        };
+
+        // Array elements stored inline after the header, starting at the first
+        // multiple of the requested alignment. The allocation itself has that
+        // alignment, so elements are aligned in absolute terms.
+        template <typename T>
+        struct ArrayBlock final : ControlBlock {
+            size_t size;
+            size_t align;
+
+            ArrayBlock(size_t size, size_t align) : size(size), align(align) {}
+
+            static size_t Offset(size_t align) noexcept {
+                return (sizeof(ArrayBlock) + align - 1) & ~(align - 1);
+            }
+
+            T* Elements() noexcept {
+                return std::launder(reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(this) + Offset(align)));
+            }
+
+            // Value-initialize or default-initialize n elements
+            template <bool ValueInit>
+            static ArrayBlock* Create(size_t n, size_t align) {
+                align = std::max({align, alignof(T), alignof(ArrayBlock)});
+                size_t offset = Offset(align);
+                if (n > (SIZE_MAX - offset) / sizeof(T)) throw std::bad_array_new_length();
+
+                void* memory = ::operator new(offset + n * sizeof(T), std::align_val_t(align));
+                auto* block = ::new (memory) ArrayBlock(n, align);
+                try {
+                    if constexpr (ValueInit)
+                        std::uninitialized_value_construct_n(block->Elements(), n);
+                    else
+                        std::uninitialized_default_construct_n(block->Elements(), n);
+                } catch (...) {
+                    block->~ArrayBlock();
+                    ::operator delete(memory, std::align_val_t(align));
+                    throw;
+                }
+                if constexpr (instrumented) CountMake(CountersFor<T[]>(), n * sizeof(T));
+                return block;
+            }
+
+            void Dispose() noexcept override {
+                if constexpr (instrumented) CountDestroy(CountersFor<T[]>(), size * sizeof(T));
+                std::destroy_n(Elements(), size);
+            }
+
+            void Deallocate() noexcept override {
+                size_t alignment = align;
+                this->~ArrayBlock();
+                ::operator delete(static_cast<void*>(this), std::align_val_t(alignment));
+            }
+        };
+
+        // Inline block whose memory comes from an allocator backend. Stateless
+        // backends take no space; stateful ones are remembered by pointer so
+        // the memory goes back where it came from.
+        template <typename T, typename Alloc>
+        struct AllocatedBlock final : InlineBlock<T> {
+            static constexpr bool stateless = std::is_empty_v<Alloc>;
+
+            [[no_unique_address]] std::conditional_t<stateless, Alloc, Alloc*> alloc;
+
+            template <typename... Args>
+            static AllocatedBlock* Create(Alloc& owner, Args&&... args) {
+                void* memory = owner.template Allocate<AllocatedBlock>();
+                try {
+                    return ::new (memory) AllocatedBlock(owner, std::forward<Args>(args)...);
+                } catch (...) {
+                    owner.template Deallocate<AllocatedBlock>(memory);
+                    throw;
+                }
+            }
+
+            template <typename... Args>
+            explicit AllocatedBlock(Alloc& owner, Args&&... args)
+                : InlineBlock<T>(std::forward<Args>(args)...) {
+                if constexpr (!stateless) alloc = &owner;
+            }
+
+            void Deallocate() noexcept override {
+                if constexpr (stateless) {
+                    Alloc owner;
+                    this->~AllocatedBlock();
+                    owner.template Deallocate<AllocatedBlock>(this);
+                } else {
+                    Alloc* owner = alloc;
+                    this->~AllocatedBlock();
+                    owner->template Deallocate<AllocatedBlock>(this);
+                }
+            }
+        };
+
+        // Free list of fixed-size slots, shared by every block type of the same
+        // size and alignment. Each thread allocates from and frees into its own
+        // cache and only takes the lock to move a batch of slots to or from the
+        // shared list, or when it exits. Once a thread's cache is gone, as
+        // during static destruction on the main thread, it uses the shared
+        // list directly.
+        template <size_t Size, size_t Align>
+        class FixedPool {
+
+            union Slot {
+                Slot* next;
+                alignas(Align) unsigned char bytes[Size];
+            };
+
+            static constexpr size_t batch = 64;
+
+            struct Shared {
+                std::mutex mutex;
+                Slot* free = nullptr;
+            };
+
+            struct Cache {
+                Slot* free = nullptr;
+                size_t size = 0;
+
+                ~Cache() {
+                    GiveBack(size);
+                    cache_gone = true;
+                }
+
+                // Move the first n cached slots to the shared list
+                void GiveBack(size_t n) noexcept {
+                    if (n == 0) return;
+                    Slot* first = free;
+                    Slot* last = free;
+                    for (size_t i = 1; i < n; ++i) last = last->next;
+                    free = last->next;
+                    size -= n;
+                    Shared& shared = GetShared();
+                    std::lock_guard<std::mutex> lock(shared.mutex);
+                    last->next = shared.free;
+                    shared.free = first;
+                }
+
+                void Refill() {
+                    Shared& shared = GetShared();
+                    {
+                        std::lock_guard<std::mutex> lock(shared.mutex);
+                        while (shared.free && size < batch) {
+                            Slot* slot = shared.free;
+                            shared.free = slot->next;
+                            slot->next = free;
+                            free = slot;
+                            ++size;
+                        }
+                    }
+                    if (free) return;
+
+                    // Chunks are never returned to the system; their slots are reused
+                    Slot* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * batch, std::align_val_t(alignof(Slot))));
+                    for (size_t i = 0; i < batch; ++i) {
+                        chunk[i].next = free;
+                        free = &chunk[i];
+                    }
+                    size = batch;
+                }
+            };
+
+            // Never destroyed, so blocks released during static destruction are safe
+            static Shared& GetShared() {
+                static Shared* shared = new Shared;
+                return *shared;
+            }
+
+            // Trivially destructible, so still readable after the cache is gone
+            static inline thread_local bool cache_gone = false;
+
+            static Cache* GetCache() noexcept {
+                if (cache_gone) return nullptr;
+                thread_local Cache cache;
+                return &cache;
+            }
+
+        public:
+
+            static void* Allocate() {
+                Cache* cache = GetCache();
+                if (!cache) {
+                    Shared& shared = GetShared();
+                    {
+                        std::lock_guard<std::mutex> lock(shared.mutex);
+                        if (Slot* slot = shared.free) {
+                            shared.free = slot->next;
+                            return slot;
+                        }
+                    }
+                    return ::operator new(sizeof(Slot), std::align_val_t(alignof(Slot)));
+                }
+                if (!cache->free) cache->Refill();
+                Slot* slot = cache->free;
+                cache->free = slot->next;
+                --cache->size;
+                return slot;
+            }
+
+            static void Deallocate(void* memory) noexcept {
+                Slot* slot = static_cast<Slot*>(memory);
+                Cache* cache = GetCache();
+                if (!cache) {
+                    Shared& shared = GetShared();
+                    std::lock_guard<std::mutex> lock(shared.mutex);
+                    slot->next = shared.free;
+                    shared.free = slot;
+                    return;
+                }
+                slot->next = cache->free;
+                cache->free = slot;
+                if (++cache->size > 2 * batch) cache->GiveBack(batch);
+            }
+
+        };
+
+        // Block for an object allocated on its own, such as one made by a
+        // Boost archive while loading
+        template <typename T>
+        struct PointerBlock final : ControlBlock {
+            T* object;
+
+            explicit PointerBlock(T* object) : object(object) {
+                if constexpr (instrumented) CountMake(CountersFor<T>(), sizeof(T));
+            }
+
+            void Dispose() noexcept override {
+                if constexpr (instrumented) CountDestroy(CountersFor<T>(), sizeof(T));
+                delete object;
+            }
+
+            void Deallocate() noexcept override {
+                delete this;
+            }
+        };
+
+        // Kept by each input archive so that every Ptr loaded for the same object
+        // shares one control block, whichever of its types it was loaded as. Like
+        // Boost's shared_ptr_helper it holds a strong reference to each loaded
+        // object, so Boost never hands back an alias of an object already gone.
+        // The references go when the archive is closed, leaving counts exact.
+        class SerializationHelper {
+
+        public:
+
+            // block is null for intrusive objects, which count in themselves
+            struct Entry {
+                ControlBlock* block;
+                void* object;
+                void (*release)(ControlBlock*, void*) noexcept;
+            };
+
+            ~SerializationHelper() {
+                for (auto& [object, entry] : entries_) entry.release(entry.block, entry.object);
+            }
+
+            // object is the address of the most derived object
+            const Entry* Find(const void* object) const {
+                auto found = entries_.find(object);
+                return found == entries_.end() ? nullptr : &found->second;
+            }
+
+            // Takes over a strong reference, released with entry.release
+            void Insert(const void* object, const Entry& entry) {
+                entries_.emplace(object, entry);
+            }
+
+        private:
+
+            std::unordered_map<const void*, Entry> entries_;
+
+        };
+
+        // Distinguishes SerializationHelper from other helpers on an archive
+        inline char serialization_helper_id;
+
+        template <typename CountPolicy>
+        void ReleaseWeak(ControlBlock* block) noexcept {
+            if (CountPolicy::Decrement(block->weak))
+                block->Deallocate();
+        }
+
+        // Selects the constructor that takes over a reference already counted
+        struct AdoptRef {};
+
+        // Stands in for the control block pointer when the count lives in the
+        // object, so an intrusive Ptr is a single pointer wide
+        struct NoBlock {
+            NoBlock() = default;
+            NoBlock(std::nullptr_t) noexcept {}
+            explicit operator bool() const noexcept { return false; }
+        };
+
+    }
+
+    // Reference count policies. LocalCount is the plain single-threaded
+    // default; AtomicCount makes copying and releasing safe across threads.
+    struct LocalCount {
+        static void Increment(uint32_t& count) noexcept {
+            ++count;
+        }
+
+        // True when this was the last reference
+        static bool Decrement(uint32_t& count) noexcept {
+            return --count == 0;
+        }
+
+        // Used by WeakPtr::Lock so an expired object is never revived
+        static bool IncrementIfNonZero(uint32_t& count) noexcept {
+            if (count == 0) return false;
+            ++count;
+            return true;
+        }
+
+        static uint32_t Load(const uint32_t& count) noexcept {
+            return count;
+        }
+    };
+
+    struct AtomicCount {
+        static void Increment(uint32_t& count) noexcept {
+            // A new reference can only be made from an existing one, so no ordering is needed
+            std::atomic_ref<uint32_t>(count).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Release publishes this owner's writes; the final owner acquires them
+        // all before the object is destroyed.
+        static bool Decrement(uint32_t& count) noexcept {
+            if (std::atomic_ref<uint32_t>(count).fetch_sub(1, std::memory_order_release) == 1) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return true;
+            }
+            return false;
+        }
+
+        static bool IncrementIfNonZero(uint32_t& count) noexcept {
+            std::atomic_ref<uint32_t> ref(count);
+            uint32_t current = ref.load(std::memory_order_relaxed);
+            while (current != 0) {
+                if (ref.compare_exchange_weak(current, current + 1, std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        static uint32_t Load(const uint32_t& count) noexcept {
+            return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(count)).load(std::memory_order_relaxed);
+        }
+    };
+
+    // Allocator backends for Ptr::AllocateWith. A backend hands out memory for
+    // one control block at a time through Allocate<Block>() and takes it back
+    // through Deallocate<Block>(memory).
+
+    // Stateless pool of fixed-size slots per block size, with thread-local
+    // caches. Memory freed on another thread joins that thread's cache.
+    struct Pool {
+        template <typename Block>
+        void* Allocate() {
+            return ptr_detail::FixedPool<sizeof(Block), alignof(Block)>::Allocate();
+        }
+
+        template <typename Block>
+        void Deallocate(void* memory) noexcept {
+            ptr_detail::FixedPool<sizeof(Block), alignof(Block)>::Deallocate(memory);
+        }
+    };
+
+    // Bump allocator for request-scoped objects. Objects are still destroyed by
+    // their last Ptr, but their memory is only reclaimed in bulk by Reset() or
+    // the arena's destructor, so no Ptr may outlive the arena. Not thread-safe.
+    class Arena {
+
+    private:
+
+        struct Chunk {
+            void* memory;
+            size_t size;
+        };
+
+        std::vector<Chunk> chunks_;
+        size_t chunk_size_;
+        size_t current_ = 0;    // index into chunks_
+        size_t offset_ = 0;     // bytes used in the current chunk
+        size_t live_ = 0;
+
+        void* Take(size_t size, size_t align) {
+            for (; current_ < chunks_.size(); ++current_, offset_ = 0) {
+                const Chunk& chunk = chunks_[current_];
+                uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memory);
+                size_t start = ((base + offset_ + align - 1) & ~uintptr_t(align - 1)) - base;
+                if (start + size <= chunk.size) {
+                    offset_ = start + size;
+                    return reinterpret_cast<void*>(base + start);
+                }
+            }
+            size_t bytes = std::max(chunk_size_, size + align);
+            chunks_.push_back({::operator new(bytes), bytes});
+            return Take(size, align);
+        }
+
+    public:
+
+        explicit Arena(size_t chunk_size = 64 * 1024) : chunk_size_(chunk_size) {}
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        ~Arena() {
+            assert(live_ == 0 && "Ptr outlived its arena");
+            for (const Chunk& chunk : chunks_) ::operator delete(chunk.memory);
+        }
+
+        template <typename Block>
+        void* Allocate() {
+            void* memory = Take(sizeof(Block), alignof(Block));
+            ++live_;
+            return memory;
+        }
+
+        template <typename Block>
+        void Deallocate(void*) noexcept {
+            --live_;
+        }
+
+        // Reuse all memory for the next batch of objects
+        void Reset() {
+            if (live_ != 0) throw ArenaInUse();
+            current_ = 0;
+            offset_ = 0;
+        }
+
+        // Blocks handed out and not yet released
+        size_t Live() const noexcept {
+            return live_;
+        }
+
+    };
+
+    // Base for types that carry their own reference count. Pointed to through
+    // a Ptr with an Intrusive policy, the object needs no control block. Copying
+    // an object does not copy its count. Delete through a base class requires
+    // that base to have a virtual destructor, as with any polymorphic delete.
+    class RefCounted {
+
+        template <typename U, typename C>
+        friend class Ptr;
+
+        alignas(std::atomic_ref<uint32_t>::required_alignment) mutable uint32_t ref_count_ = 0;
+
+    protected:
+        RefCounted() noexcept = default;
+        RefCounted(const RefCounted&) noexcept {}
+        RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+        ~RefCounted() = default;
+    };
+
+    // Count policy for types derived from RefCounted, counting with Base
+    template <typename Base = LocalCount>
+    struct Intrusive : Base {};
+
+    namespace ptr_detail {
+
+        template <typename CountPolicy>
+        inline constexpr bool is_intrusive = false;
+
+        template <typename Base>
+        inline constexpr bool is_intrusive<Intrusive<Base>> = true;
+
+    }
+
+    // Picks the count policy used when Ptr<T> is spelled without one. Specialize
+    // it before first use, e.g. with Intrusive<> for a type derived from RefCounted.
+    // Looked up without cv-qualifiers, so Ptr<const T> counts the same way.
+    template <typename T>
+    struct PtrTraits {
+        using CountPolicy = LocalCount;
+    };
+
+    namespace ptr_detail {
+
+        // Link in the reclaimer's queue, embedded in each deferred block
+        struct DeferredNode {
+            DeferredNode* next = nullptr;
+            int64_t queued_ns = 0;
+            void (*reclaim)(DeferredNode*) noexcept = nullptr;
+        };
+
+        inline int64_t NowNs() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    }
+
+    // Destroys objects made with Ptr::MakeDeferred after their last reference
+    // is gone, instead of on the releasing thread. Releasing only pushes the
+    // block onto a lock-free queue; the objects are destroyed, oldest first,
+    // by Collect() at a safe point or by the background thread from Start().
+    //
+    // On the background thread, an object's destructor and its release of any
+    // Ptrs it owns run concurrently with the rest of the program, so those
+    // Ptrs, and any WeakPtrs to the object, must use AtomicCount unless they
+    // are not shared. Collect() on the owning thread has no such restriction.
+    class Reclaimer {
+
+    public:
+
+        struct Stats {
+            size_t depth;               // objects waiting to be destroyed
+            uint64_t deferred;          // objects ever queued
+            uint64_t reclaimed;         // objects destroyed from the queue
+            uint64_t max_latency_ns;    // longest wait in the queue
+            uint64_t total_latency_ns;  // sum of waits, for the mean
+        };
+
+    private:
+
+        struct State {
+            std::atomic<ptr_detail::DeferredNode*> incoming{nullptr};
+
+            std::mutex collect_mutex;
+            ptr_detail::DeferredNode* pending = nullptr;   // oldest first
+            ptr_detail::DeferredNode* pending_tail = nullptr;
+
+            std::atomic<size_t> depth{0};
+            std::atomic<uint64_t> deferred{0};
+            std::atomic<uint64_t> reclaimed{0};
+            std::atomic<uint64_t> max_latency_ns{0};
+            std::atomic<uint64_t> total_latency_ns{0};
+
+            std::mutex thread_mutex;
+            std::condition_variable wake;
+            std::thread worker;
+            bool running = false;
+        };
+
+        // Never destroyed, so objects released during static destruction are safe
+        static State& GetState() {
+            static State* state = new State;
+            return *state;
+        }
+
+        static void Work(std::chrono::microseconds interval, size_t batch) {
+            State& state = GetState();
+            std::unique_lock<std::mutex> lock(state.thread_mutex);
+            while (state.running) {
+                lock.unlock();
+                size_t collected = Collect(batch);
+                lock.lock();
+                if (collected < batch)
+                    state.wake.wait_for(lock, interval);
+            }
+        }
+
+    public:
+
+        // Queue a block whose last reference is gone. Lock-free.
+        static void Defer(ptr_detail::DeferredNode* node) noexcept {
+            State& state = GetState();
+            // Counted before the push, so a collector never sees depth go negative
+            state.deferred.fetch_add(1, std::memory_order_relaxed);
+            state.depth.fetch_add(1, std::memory_order_relaxed);
+            node->queued_ns = ptr_detail::NowNs();
+            node->next = state.incoming.load(std::memory_order_relaxed);
+            while (!state.incoming.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+
+        // Destroy up to max queued objects, oldest first, on the calling thread.
+        // Objects released by those destructors are queued for a later call.
+        // The destructors run outside the queue's lock, so they may call
+        // Collect themselves.
+        static size_t Collect(size_t max = SIZE_MAX) {
+            State& state = GetState();
+            ptr_detail::DeferredNode* taken = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(state.collect_mutex);
+
+                // The incoming stack is newest first; append it to pending reversed
+                ptr_detail::DeferredNode* newest = state.incoming.exchange(nullptr, std::memory_order_acquire);
+                ptr_detail::DeferredNode* batch = nullptr;
+                ptr_detail::DeferredNode* batch_tail = newest;
+                while (newest) {
+                    ptr_detail::DeferredNode* next = newest->next;
+                    newest->next = batch;
+                    batch = newest;
+                    newest = next;
+                }
+                if (batch) {
+                    if (state.pending_tail) state.pending_tail->next = batch;
+                    else state.pending = batch;
+                    state.pending_tail = batch_tail;
+                }
+
+                // Detach up to max of the oldest
+                taken = state.pending;
+                ptr_detail::DeferredNode* last = nullptr;
+                for (size_t n = 0; n < max && state.pending; ++n) {
+                    last = state.pending;
+                    state.pending = last->next;
+                }
+                if (last) last->next = nullptr;
+                if (!state.pending) state.pending_tail = nullptr;
+            }
+
+            size_t collected = 0;
+            while (taken) {
+                ptr_detail::DeferredNode* node = taken;
+                taken = node->next;
+
+                uint64_t latency = uint64_t(ptr_detail::NowNs() - node->queued_ns);
+                node->reclaim(node);
+                ++collected;
+
+                state.depth.fetch_sub(1, std::memory_order_relaxed);
+                state.reclaimed.fetch_add(1, std::memory_order_relaxed);
+                state.total_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+                uint64_t longest = state.max_latency_ns.load(std::memory_order_relaxed);
+                while (latency > longest && !state.max_latency_ns.compare_exchange_weak(longest, latency, std::memory_order_relaxed)) {}
+            }
+            return collected;
+        }
+
+        // Reclaim on a background thread, in batches of up to batch objects,
+        // polling every interval while the queue is short. Stopped at exit.
+        static void Start(std::chrono::microseconds interval = std::chrono::milliseconds(1), size_t batch = 1024) {
+            State& state = GetState();
+            std::lock_guard<std::mutex> lock(state.thread_mutex);
+            if (state.running) return;
+            static std::once_flag registered;
+            std::call_once(registered, [] { std::atexit([] { Stop(); }); });
+            state.running = true;
+            state.worker = std::thread(Work, interval, batch);
+        }
+
+        // Stop the background thread and reclaim whatever is left
+        static void Stop() {
+            State& state = GetState();
+            {
+                std::lock_guard<std::mutex> lock(state.thread_mutex);
+                if (!state.running) return;
+                state.running = false;
+            }
+            state.wake.notify_all();
+            state.worker.join();
+            while (Collect() != 0) {}
+        }
+
+        static Stats GetStats() noexcept {
+            State& state = GetState();
+            return Stats{
+                state.depth.load(std::memory_order_relaxed),
+                state.deferred.load(std::memory_order_relaxed),
+                state.reclaimed.load(std::memory_order_relaxed),
+                state.max_latency_ns.load(std::memory_order_relaxed),
+                state.total_latency_ns.load(std::memory_order_relaxed),
+            };
+        }
+
+    };
+
+    namespace ptr_detail {
+
+        // Inline block whose object is destroyed through the Reclaimer. The
+        // last Ptr's Dispose only queues it, taking a weak reference so the
+        // block outlives the queue entry.
+        template <typename T, typename CountPolicy>
+        struct DeferredBlock final : InlineBlock<T>, DeferredNode {
+
+            template <typename... Args>
+            explicit DeferredBlock(Args&&... args) : InlineBlock<T>(std::forward<Args>(args)...) {
+                reclaim = &Reclaim;
+            }
+
+            // The queue takes over the strong side's weak reference, so the
+            // releasing thread is done with the block once it is queued
+            bool Expire() noexcept override {
+                Reclaimer::Defer(this);
+                return false;
+            }
+
+            void Deallocate() noexcept override {
+                delete this;
+            }
+
+            static void Reclaim(DeferredNode* node) noexcept {
+                auto* block = static_cast<DeferredBlock*>(node);
+                block->Dispose();
+                ReleaseWeak<CountPolicy>(block);
+            }
+        };
+
+    }
+
+    template <typename T, typename CountPolicy>
+    class WeakPtr;
+
+    template <typename T, typename CountPolicy = typename PtrTraits<std::remove_cv_t<T>>::CountPolicy>
+    class Ptr {
+
+        friend class boost::serialization::access;
+
+        // The object goes through Boost's pointer tracking, so an object shared
+        // by several Ptrs is written once, polymorphic types included when
+        // their classes are exported or registered
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const {
+            const T* raw = ptr_;
+            ar << boost::serialization::make_nvp("pointer", raw);
+        }
+
+        // Boost hands back the same object for every alias; the archive's
+        // SerializationHelper maps it to the control block made for the first
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version){
+            T* raw = nullptr;
+            ar >> boost::serialization::make_nvp("pointer", raw);
+
+            Ptr loaded;
+            if (raw) {
+                const void* object;
+                if constexpr (std::is_polymorphic_v<T>)
+                    object = dynamic_cast<const void*>(raw);
+                else
+                    object = raw;
+
+                auto& helper = ar.template get_helper<ptr_detail::SerializationHelper>(&ptr_detail::serialization_helper_id);
+                const auto* entry = helper.Find(object);
+                if constexpr (intrusive) {
+                    loaded = Ptr(raw, Block());
+                    if (!entry) {
+                        if constexpr (ptr_detail::instrumented) {
+                            auto& counters = ptr_detail::CountersOf(raw);
+                            ptr_detail::CountMake(counters, counters.object_size);
+                        }
+                        loaded.retain();
+                        helper.Insert(object, {nullptr, raw, &Ptr::ReleaseLoaded});
+                    }
+                } else if (entry) {
+                    loaded = Ptr(raw, entry->block);
+                } else {
+                    // The block's first reference belongs to the helper
+                    auto* created = new ptr_detail::PointerBlock<T>(raw);
+                    helper.Insert(object, {created, raw, &Ptr::ReleaseLoaded});
+                    loaded = Ptr(raw, static_cast<ptr_detail::ControlBlock*>(created));
+                }
+            }
+            *this = std::move(loaded);
+        }
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    private:
+
+        static constexpr bool intrusive = ptr_detail::is_intrusive<CountPolicy>;
+
+        using Block = std::conditional_t<intrusive, ptr_detail::NoBlock, ptr_detail::ControlBlock*>;
+
+        T* ptr_ = nullptr;
+        [[no_unique_address]] Block block_ = nullptr;
+
+        // Private constructor for cross-type initialization
+        template <typename U>
+        Ptr(U* ptr, Block block) : ptr_(ptr), block_(block) {
+            retain();
+        }
+
+        // Takes ownership of a freshly made block (count already 1)
+        explicit Ptr(ptr_detail::InlineBlock<T>* block) : ptr_(block->Object()), block_(block) {}
+
+        // Takes over a reference the caller has already counted
+        Ptr(T* ptr, Block block, ptr_detail::AdoptRef) : ptr_(ptr), block_(block) {}
+
+        // The count shared by every reference to this object, or null
+        uint32_t* counter() const noexcept {
+            if constexpr (intrusive)
+                return ptr_ ? &static_cast<const RefCounted*>(ptr_)->ref_count_ : nullptr;
+            else
+                return block_ ? &block_->count : nullptr;
+        }
+
+        void retain() noexcept {
+            if (uint32_t* count = counter()) CountPolicy::Increment(*count);
+        }
+
+        // Drops the reference a SerializationHelper holds on a loaded object
+        static void ReleaseLoaded(ptr_detail::ControlBlock* block, void* object) noexcept {
+            if constexpr (intrusive)
+                Ptr released(static_cast<T*>(object), Block(), ptr_detail::AdoptRef{});
+            else
+                Ptr released(static_cast<T*>(object), block, ptr_detail::AdoptRef{});
+        }
+
+    public:
+        // Friend all other Ptr templates
+        template <typename U, typename C>
+        friend class Ptr;
+
+        template <typename U, typename C>
+        friend class WeakPtr;
+
+        template <typename U, typename C>
+        friend class AtomicPtr;
+
+        // Prohibit heap allocation
+        void* operator new(size_t) = delete;
+        void operator delete(void*) = delete;
+
+        // Ptr factory method
+        template <typename... Args>
+        static Ptr Make(Args&&... args) {
+            if constexpr (intrusive) {
+                Ptr made(new T(std::forward<Args>(args)...), Block());
+                if constexpr (ptr_detail::instrumented) {
+                    auto& counters = ptr_detail::CountersFor<T>();
+                    ptr_detail::CountMake(counters, counters.object_size);
+                }
+                return made;
+            }
+            else
+                return Ptr(new ptr_detail::MadeBlock<T>(std::forward<Args>(args)...));
+        }
+
+        // Make an object whose destruction is left to the Reclaimer. With a
+        // non-atomic count and a background Reclaimer, WeakPtrs to it must be
+        // dropped before its last Ptr is.
+        template <typename... Args>
+        static Ptr MakeDeferred(Args&&... args) {
+            static_assert(!intrusive, "Intrusive objects are always deleted by their last Ptr");
+            return Ptr(new ptr_detail::DeferredBlock<T, CountPolicy>(std::forward<Args>(args)...));
+        }
+
+        // Make with memory from a stateful allocator backend such as an Arena
+        template <typename Alloc, typename... Args>
+            requires (!std::is_empty_v<Alloc>)
+        static Ptr AllocateWith(Alloc& alloc, Args&&... args) {
+            static_assert(!intrusive, "Intrusive objects are always made with new");
+            return Ptr(ptr_detail::AllocatedBlock<T, Alloc>::Create(alloc, std::forward<Args>(args)...));
+        }
+
+        // Make with memory from a stateless allocator backend such as Pool
+        template <typename Alloc, typename... Args>
+            requires std::is_empty_v<Alloc>
+        static Ptr AllocateWith(Args&&... args) {
+            static_assert(!intrusive, "Intrusive objects are always made with new");
+            Alloc alloc;
+            return Ptr(ptr_detail::AllocatedBlock<T, Alloc>::Create(alloc, std::forward<Args>(args)...));
+        }
+
+        Ptr() : ptr_(nullptr), block_(nullptr) {}
+
+        Ptr(std::nullptr_t) : ptr_(nullptr), block_(nullptr) {}
+        
+        // Copy constructor
+        Ptr(const Ptr& other) : ptr_(other.ptr_), block_(other.block_) {
+            retain();
+            if constexpr (ptr_detail::instrumented) if (ptr_) ptr_detail::CountCopy<T>();
+        }
+
+        // Move constructor
+        Ptr(Ptr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+            if constexpr (ptr_detail::instrumented) if (ptr_) ptr_detail::CountMove<T>();
+            other.ptr_ = nullptr;
+            other.block_ = nullptr;
+        }
+        
+        explicit Ptr(const T& value) : Ptr(Make(value)) {}
+
+        // Destructor
+        ~Ptr() {
+            free();
+        }
+
+        // Drop this reference; the last one destroys the object, and the block
+        // goes too unless a WeakPtr still refers to it. This Ptr is cleared
+        // first, as it may live inside the object being destroyed.
+        void free() {
+
+            T* ptr = std::exchange(ptr_, nullptr);
+            Block block = std::exchange(block_, nullptr);
+
+            if constexpr (intrusive) {
+                if (ptr && CountPolicy::Decrement(static_cast<const RefCounted*>(ptr)->ref_count_)) {
+                    if constexpr (ptr_detail::instrumented) {
+                        auto& counters = ptr_detail::CountersOf(ptr);
+                        ptr_detail::CountDestroy(counters, counters.object_size);
+                    }
+                    delete ptr;
+                }
+            }
+            else if (block && CountPolicy::Decrement(block->count)) {
+                if (block->Expire() && CountPolicy::Decrement(block->weak))
+                    block->Deallocate();
+            }
+
+        }
+
+        Ptr& operator=(std::nullptr_t) {
+            free();
+            return *this;
+        }
+
+        // Assignment takes the new reference before dropping the old one, which
+        // may own other, as in head = head->next
+        Ptr& operator=(const Ptr& other) {
+            Ptr(other).swap(*this);
+            return *this;
+        }
+
+        // Move assignment operator
+        Ptr& operator =(Ptr&& other) noexcept {
+            Ptr(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(Ptr& other) noexcept {
+            std::swap(ptr_, other.ptr_);
+            std::swap(block_, other.block_);
+        }
+
+        // Comparisons go by object address, against a Ptr of any related type
+        // or a raw pointer, in the same total order as std::less on pointers.
+        // != and the relational operators are derived from these.
+        template <typename U, typename C>
+        bool operator ==(const Ptr<U, C> & other) const noexcept {
+            return ptr_ == other.ptr_;
+        }
+        template <typename U, typename C>
+        std::strong_ordering operator <=>(const Ptr<U, C> & other) const noexcept {
+            return std::compare_three_way()(ptr_, other.ptr_);
+        }
+        template <typename U>
+        bool operator ==(const U * other) const noexcept {
+            return ptr_ == other;
+        }
+        template <typename U>
+        std::strong_ordering operator <=>(const U * other) const noexcept {
+            return std::compare_three_way()(ptr_, other);
+        }
+        bool operator ==(std::nullptr_t) const noexcept {
+            return ptr_ == nullptr;
+        }
+        std::strong_ordering operator <=>(std::nullptr_t) const noexcept {
+            return std::compare_three_way()(ptr_, static_cast<T*>(nullptr));
+        }
+        
+        // Check if initialized
+        explicit operator bool() const noexcept {
+            return ptr_ != nullptr;
+        }
+
+        friend ostream& operator<<(ostream& os, const Ptr& ptr){
+            os << ptr.ptr_;
+            return os;
+        }
+
+        // Dereference operators, null-checked according to PTR_NULL_CHECK
+        T& operator*() const noexcept(!ptr_detail::checked_dereference) {
+            ptr_detail::CheckNotNull(ptr_);
+            return *ptr_;
+        }
+
+        T* operator->() const noexcept(!ptr_detail::checked_dereference) {
+            ptr_detail::CheckNotNull(ptr_);
+            return ptr_;
+        }
+    
+        string Addr(){
+            const void * address = static_cast<const void*>(ptr_);
+            stringstream ss;
+            ss << address;
+            return ss.str();
+        }
+
+        T & Get() const noexcept {
+            return *ptr_;
+        }
 
-    class PointerAlreadyInitialized : public exception {
-    public:
-        const char* what() const noexcept override {
-            return "Tried to reinitialize a pointer that already exists.";
+        // The object's address, or null; never checked
+        T* Raw() const noexcept {
+            return ptr_;
         }
-    };
 
-    template <typename T>
-    class Ptr {
+        // Get reference count
+        uint32_t Count() const noexcept {
+            const uint32_t* count = counter();
+            return count ? CountPolicy::Load(*count) : 0;
+        }
 
-        friend class boost::serialization::access;
-        template<class Archive>
-        void serialize(Archive & ar, const unsigned int version){
-            ar & boost::serialization::make_nvp("pointer", ptr_); // Serialize raw pointer
-            //ar & boost::serialization::make_nvp("ref_count", *ref_count_);
+        // Check uniqueness
+        bool Unique() const noexcept {
+            return Count() == 1;
         }
 
-    private:
+        // Type information: the demangled name of the object's dynamic type
+        const string& Type() const {
+            if (!ptr_) return ptr_detail::null_name;
+            return ptr_detail::DemangledName(typeid(*ptr_));
+        }
 
-        T* ptr_ = nullptr;
-        uint32_t* ref_count_ = nullptr;
+        // Safe casting method. Upcasts are resolved at compile time; anything
+        // else is checked with dynamic_cast.
+        template <typename U>
+        Ptr<U, CountPolicy> Cast() const {
+            U* casted;
+            if constexpr (std::is_convertible_v<T*, U*>)
+                casted = ptr_;
+            else
+                casted = dynamic_cast<U*>(ptr_);
+            if (!casted) return Ptr<U, CountPolicy>();  // Return null if cast failed
+        
+            // The new Ptr<U> shares this object's control block, so whichever
+            // reference is released last destroys the object through its real type.
+            Ptr<U, CountPolicy> newPtr(casted, block_);
+            return newPtr;
+        }
 
-        // Private constructor for cross-type initialization
+        // Unchecked cast for conversions known to be valid, such as a downcast
+        // to the object's real type
+        template <typename U>
+        Ptr<U, CountPolicy> StaticCast() const {
+            return Ptr<U, CountPolicy>(static_cast<U*>(ptr_), block_);
+        }
+
+        // Add or remove const
         template <typename U>
-        Ptr(U* ptr, uint32_t* ref_count) : ptr_(ptr), ref_count_(ref_count) {
-            if (ref_count_) ++(*ref_count_);
+        Ptr<U, CountPolicy> ConstCast() const {
+            return Ptr<U, CountPolicy>(const_cast<U*>(ptr_), block_);
         }
 
-        explicit Ptr(T* ptr) : ptr_(ptr), ref_count_(new uint32_t(1)) {}
+    };
+
+    // Array specialization: Ptr<T[]> owns n elements stored inline after the
+    // count, in one allocation. MakeAligned aligns the first element, e.g. to a
+    // cache line for SIMD kernels; Uninitialized variants default-initialize,
+    // which leaves trivial element types such as float uninitialized.
+    template <typename T, typename CountPolicy>
+    class Ptr<T[], CountPolicy> {
+
+        static_assert(!ptr_detail::is_intrusive<CountPolicy>, "Arrays keep their count in a control block");
+
+    private:
+
+        using Block = ptr_detail::ArrayBlock<T>;
+
+        T* ptr_ = nullptr;
+        Block* block_ = nullptr;
+
+        // Takes ownership of a freshly made block (count already 1)
+        explicit Ptr(Block* block) : ptr_(block->Elements()), block_(block) {}
 
     public:
         // Friend all other Ptr templates
-        template <typename U>
+        template <typename U, typename C>
         friend class Ptr;
 
         // Prohibit heap allocation
         void* operator new(size_t) = delete;
         void operator delete(void*) = delete;
 
-        // Ptr factory method
-        template <typename... Args>
-        static Ptr<T> Make(Args&&... args) {
-            return Ptr<T>(new T(std::forward<Args>(args)...));
+        // Ptr factory methods: n value-initialized elements
+        static Ptr Make(size_t n) {
+            return Ptr(Block::template Create<true>(n, alignof(T)));
         }
-        
-        Ptr() : ptr_(nullptr), ref_count_(nullptr) {}
 
-        Ptr(std::nullptr_t) : ptr_(nullptr), ref_count_(nullptr) {}
-        
+        template <size_t Align>
+        static Ptr MakeAligned(size_t n) {
+            static_assert(Align != 0 && (Align & (Align - 1)) == 0, "Alignment must be a power of two");
+            return Ptr(Block::template Create<true>(n, Align));
+        }
+
+        // n default-initialized elements
+        static Ptr MakeUninitialized(size_t n) {
+            return Ptr(Block::template Create<false>(n, alignof(T)));
+        }
+
+        template <size_t Align>
+        static Ptr MakeAlignedUninitialized(size_t n) {
+            static_assert(Align != 0 && (Align & (Align - 1)) == 0, "Alignment must be a power of two");
+            return Ptr(Block::template Create<false>(n, Align));
+        }
+
+        Ptr() : ptr_(nullptr), block_(nullptr) {}
+
+        Ptr(std::nullptr_t) : ptr_(nullptr), block_(nullptr) {}
+
         // Copy constructor
-        Ptr(const Ptr& other) : ptr_(other.ptr_), ref_count_(other.ref_count_) {
-            //free();
-            if (ref_count_) ++(*ref_count_);
+        Ptr(const Ptr& other) : ptr_(other.ptr_), block_(other.block_) {
+            if (block_) CountPolicy::Increment(block_->count);
+            if constexpr (ptr_detail::instrumented) if (block_) ptr_detail::CountCopy<T[]>();
         }
 
         // Move constructor
-        Ptr(Ptr&& other) noexcept : ptr_(other.ptr_), ref_count_(other.ref_count_) {
+        Ptr(Ptr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+            if constexpr (ptr_detail::instrumented) if (block_) ptr_detail::CountMove<T[]>();
             other.ptr_ = nullptr;
-            other.ref_count_ = nullptr;
+            other.block_ = nullptr;
         }
-        
-        explicit Ptr(const T& value) : ptr_(new T(value)), ref_count_(new uint32_t(1)) {}
 
         // Destructor
         ~Ptr() {
             free();
         }
 
+        // Drop this reference; the last one destroys the elements and the block
         void free() {
 
-            if (ref_count_ && --(*ref_count_) == 0) {
+            ptr_ = nullptr;
+            Block* block = std::exchange(block_, nullptr);
 
-                if(ptr_)
-                    delete ptr_;
-                if(ref_count_)
-                    delete ref_count_;
-            
-                ptr_ = nullptr;
-                ref_count_ = nullptr;
-                
+            if (block && CountPolicy::Decrement(block->count)) {
+                block->Dispose();
+                if (CountPolicy::Decrement(block->weak))
+                    block->Deallocate();
             }
 
         }
@@ -110,113 +1489,529 @@
             return *this;
         }
 
-        // Assignment operator
+        // Assignment takes the new reference before dropping the old one
         Ptr& operator=(const Ptr& other) {
-            if (this != &other) {
-                free();  // Decrement existing ref_count (if any)
-                ptr_ = other.ptr_;
-                ref_count_ = other.ref_count_;
-                if (ref_count_) {
-                    ++(*ref_count_);
-                }
-            }
+            Ptr(other).swap(*this);
             return *this;
         }
 
         // Move assignment operator
-        Ptr& operator =(Ptr&& other) noexcept {
-            if (this != &other) {
-                free();
-                ptr_ = other.ptr_;
-                ref_count_ = other.ref_count_;
-                other.ptr_ = nullptr;
-                other.ref_count_ = nullptr;
-            }
+        Ptr& operator=(Ptr&& other) noexcept {
+            Ptr(std::move(other)).swap(*this);
             return *this;
         }
 
-        bool operator <(const T * other){
-            return ptr_ < other;
+        void swap(Ptr& other) noexcept {
+            std::swap(ptr_, other.ptr_);
+            std::swap(block_, other.block_);
         }
-        bool operator >(const T * other){
-            return ptr_ > other;
-        }
-        bool operator ==(const Ptr & other){
+
+        // Compared by address of the first element, as for Ptr<T>
+        template <typename C>
+        bool operator ==(const Ptr<T[], C> & other) const noexcept {
             return ptr_ == other.ptr_;
         }
-        bool operator !=(const Ptr & other){
-            return ptr_ != other.ptr_;
+        template <typename C>
+        std::strong_ordering operator <=>(const Ptr<T[], C> & other) const noexcept {
+            return std::compare_three_way()(ptr_, other.ptr_);
         }
-        bool operator ==(const T * other){
+        bool operator ==(const T * other) const noexcept {
             return ptr_ == other;
         }
-        bool operator !=(const T * other){
-            return ptr_ != other;
+        std::strong_ordering operator <=>(const T * other) const noexcept {
+            return std::compare_three_way()(ptr_, other);
         }
-        
+        bool operator ==(std::nullptr_t) const noexcept {
+            return ptr_ == nullptr;
+        }
+        std::strong_ordering operator <=>(std::nullptr_t) const noexcept {
+            return std::compare_three_way()(ptr_, static_cast<T*>(nullptr));
+        }
+
         // Check if initialized
         explicit operator bool() const noexcept {
             return ptr_ != nullptr;
         }
 
-        friend ostream& operator<<(ostream& os, const Ptr& ptr){
-            os << ptr.ptr_;
-            return os;
+        // Element access; only checked by assert
+        T& operator[](size_t index) const noexcept {
+            assert(index < size() && "Array index out of range");
+            return ptr_[index];
         }
 
-        // Dereference operators
-        T& operator*() const {
-            if (!ptr_) throw UninitializedPointer();
-            return *ptr_;
+        size_t size() const noexcept {
+            return block_ ? block_->size : 0;
         }
 
-        T* operator->() const {
-            if (!ptr_) throw UninitializedPointer();
+        T* data() const noexcept {
             return ptr_;
         }
-    
-        string Addr(){
-            const void * address = static_cast<const void*>(ptr_);
-            stringstream ss;
-            ss << address;
-            return ss.str();
+
+        T* begin() const noexcept {
+            return ptr_;
         }
 
-        T & Get() const noexcept {
-            return *ptr_;
+        T* end() const noexcept {
+            return ptr_ + size();
+        }
+
+        std::span<T> Span() const noexcept {
+            return std::span<T>(ptr_, size());
+        }
+
+        // Alignment of the first element
+        size_t Alignment() const noexcept {
+            return block_ ? block_->align : 0;
         }
 
         // Get reference count
         uint32_t Count() const noexcept {
-            return ref_count_ ? *ref_count_ : 0;
+            return block_ ? CountPolicy::Load(block_->count) : 0;
         }
 
         // Check uniqueness
         bool Unique() const noexcept {
-            return ref_count_ && *ref_count_ == 1;
+            return Count() == 1;
         }
 
-        // Type information
-        string Type() const {
-            if (!ptr_) return "Null";
-            int status;
-            char* demangled = abi::__cxa_demangle(typeid(*ptr_).name(), 0, 0, &status);
-            string result(demangled);
-            return result;
+    };
+
+    // Non-owning reference to a Ptr's object. It keeps the control block alive
+    // but not the object, so it can observe expiry and break ownership cycles.
+    // The object is destroyed as soon as the last Ptr goes; only the block's
+    // memory, which holds a Make'd object's storage, waits for the WeakPtrs.
+    template <typename T, typename CountPolicy = typename PtrTraits<std::remove_cv_t<T>>::CountPolicy>
+    class WeakPtr {
+
+        static_assert(!ptr_detail::is_intrusive<CountPolicy>, "WeakPtr needs a control block; intrusive objects have none");
+
+    private:
+
+        T* ptr_ = nullptr;
+        ptr_detail::ControlBlock* block_ = nullptr;
+
+    public:
+
+        WeakPtr() : ptr_(nullptr), block_(nullptr) {}
+
+        WeakPtr(std::nullptr_t) : ptr_(nullptr), block_(nullptr) {}
+
+        WeakPtr(const Ptr<T, CountPolicy>& ptr) : ptr_(ptr.ptr_), block_(ptr.block_) {
+            if (block_) CountPolicy::Increment(block_->weak);
         }
 
-        // Safe casting method
-        template <typename U>
-        Ptr<U> Cast() const {
-            U* casted = dynamic_cast<U*>(ptr_);
-            if (!casted) return Ptr<U>();  // Return null if cast failed
-        
-            // Create a new Ptr<U> instance with a separate reference count
-            // This assumes the casted object should share the same ownership semantics as the original.
-            Ptr<U> newPtr(casted, ref_count_);
-            return newPtr;
+        // Copy constructor
+        WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), block_(other.block_) {
+            if (block_) CountPolicy::Increment(block_->weak);
+        }
+
+        // Move constructor
+        WeakPtr(WeakPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
+            other.ptr_ = nullptr;
+            other.block_ = nullptr;
+        }
+
+        // Destructor
+        ~WeakPtr() {
+            free();
+        }
+
+        // Drop this reference; the last one releases the control block
+        void free() {
+
+            ptr_ = nullptr;
+            ptr_detail::ControlBlock* block = std::exchange(block_, nullptr);
+
+            if (block && CountPolicy::Decrement(block->weak))
+                block->Deallocate();
+
+        }
+
+        WeakPtr& operator=(std::nullptr_t) {
+            free();
+            return *this;
+        }
+
+        WeakPtr& operator=(const Ptr<T, CountPolicy>& ptr) {
+            return *this = WeakPtr(ptr);
+        }
+
+        // Assignment takes the new reference before dropping the old one
+        WeakPtr& operator=(const WeakPtr& other) {
+            WeakPtr(other).swap(*this);
+            return *this;
+        }
+
+        // Move assignment operator
+        WeakPtr& operator=(WeakPtr&& other) noexcept {
+            WeakPtr(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(WeakPtr& other) noexcept {
+            std::swap(ptr_, other.ptr_);
+            std::swap(block_, other.block_);
+        }
+
+        // Strong reference to the object, or null if it has been destroyed
+        Ptr<T, CountPolicy> Lock() const noexcept {
+            if (block_ && CountPolicy::IncrementIfNonZero(block_->count))
+                return Ptr<T, CountPolicy>(ptr_, block_, ptr_detail::AdoptRef{});
+            return Ptr<T, CountPolicy>();
         }
 
+        // Check if the object has been destroyed (or was never set)
+        bool Expired() const noexcept {
+            return !block_ || CountPolicy::Load(block_->count) == 0;
+        }
+
+        // Get strong reference count
+        uint32_t Count() const noexcept {
+            return block_ ? CountPolicy::Load(block_->count) : 0;
+        }
+
+    };
+
+    // Ptr that is never null. The check happens once, when a Ref is made from
+    // a Ptr, so dereferencing never checks whatever PTR_NULL_CHECK says. There
+    // is no default constructor, and moving copies so the source stays valid.
+    template <typename T, typename CountPolicy = typename PtrTraits<std::remove_cv_t<T>>::CountPolicy>
+    class Ref {
+
+    private:
+
+        Ptr<T, CountPolicy> ptr_;
+
+        Ref(Ptr<T, CountPolicy>&& ptr, ptr_detail::AdoptRef) : ptr_(std::move(ptr)) {}
+
+    public:
+
+        // Ref factory method
+        template <typename... Args>
+        static Ref Make(Args&&... args) {
+            return Ref(Ptr<T, CountPolicy>::Make(std::forward<Args>(args)...), ptr_detail::AdoptRef{});
+        }
+
+        // Throws UninitializedPointer if ptr is null
+        explicit Ref(Ptr<T, CountPolicy> ptr) : ptr_(std::move(ptr)) {
+            if (!ptr_) ptr_detail::ThrowUninitialized();
+        }
+
+        Ref(const Ref& other) = default;
+        Ref& operator=(const Ref& other) = default;
+
+        // Dereference operators
+        T& operator*() const noexcept {
+            return ptr_.Get();
+        }
+
+        T* operator->() const noexcept {
+            return std::addressof(ptr_.Get());
+        }
+
+        T& Get() const noexcept {
+            return ptr_.Get();
+        }
+
+        // The underlying Ptr, for APIs that take one
+        const Ptr<T, CountPolicy>& AsPtr() const noexcept {
+            return ptr_;
+        }
+
+        operator const Ptr<T, CountPolicy>&() const noexcept {
+            return ptr_;
+        }
+
+        // Get reference count
+        uint32_t Count() const noexcept {
+            return ptr_.Count();
+        }
+
+        // Check uniqueness
+        bool Unique() const noexcept {
+            return ptr_.Unique();
+        }
+
+    };
+
+    // Ptr whose reference count may be shared between threads
+    template <typename T>
+    using SharedPtr = Ptr<T, AtomicCount>;
+
+    template <typename T>
+    using SharedWeakPtr = WeakPtr<T, AtomicCount>;
+
+    // Atomic slot holding a Ptr, for one writer publishing snapshots that many
+    // readers load. Load is lock-free; writers allocate and free nodes through
+    // the Pool, which takes a lock when moving batches of slots.
+    //
+    // The slot points at an immutable node that owns one Ptr; each Store makes
+    // a new node. The slot's top 16 bits are a local count of readers that have
+    // claimed the node but not yet copied its Ptr. A reader claims with one
+    // fetch_add on the slot, copies the Ptr, and then takes its claim back off
+    // the slot. If a writer has replaced the node in the meantime, the writer
+    // has moved the local count into the node's own count, and the reader
+    // releases it there instead, so a node is never freed while claimed.
+    // A reader never frees a node: the last one to let go of a replaced node
+    // releases the Ptr it holds, as it would its own copy, and pushes the
+    // node's memory on a retired list for the next writer to free.
+    // Nodes come from the Pool, so Store does not hit malloc in steady state.
+    // Requires user-space addresses to fit in 48 bits, as on x86-64 and AArch64.
+    template <typename T, typename CountPolicy = AtomicCount>
+    class AtomicPtr {
+
+        static_assert(std::is_base_of_v<AtomicCount, CountPolicy>, "AtomicPtr shares its Ptr between threads and needs an atomic count");
+        static_assert(sizeof(void*) == 8, "AtomicPtr packs its count into the top bits of a 64-bit pointer");
+
+    private:
+
+        struct Node {
+            std::atomic<int64_t> count{0};  // claims moved off the slot, minus releases
+            Node* next = nullptr;           // link in the retired list
+            Ptr<T, CountPolicy> value;
+
+            explicit Node(Ptr<T, CountPolicy> value) : value(std::move(value)) {}
+        };
+
+        using NodePool = ptr_detail::FixedPool<sizeof(Node), alignof(Node)>;
+
+        static constexpr int pointer_bits = 48;
+        static constexpr uint64_t one_claim = uint64_t(1) << pointer_bits;
+        static constexpr uint64_t pointer_mask = one_claim - 1;
+
+        std::atomic<uint64_t> slot_{0};
+        mutable std::atomic<Node*> retired_{nullptr};
+
+        static Node* NodeOf(uint64_t slot) noexcept {
+            return reinterpret_cast<Node*>(slot & pointer_mask);
+        }
+
+        static uint64_t ClaimsOf(uint64_t slot) noexcept {
+            return slot >> pointer_bits;
+        }
+
+        static uint64_t Pack(Node* node) noexcept {
+            uint64_t bits = reinterpret_cast<uint64_t>(node);
+            assert((bits & ~pointer_mask) == 0 && "Address does not fit in 48 bits");
+            return bits;
+        }
+
+        static Node* MakeNode(Ptr<T, CountPolicy>&& value) {
+            if (!value) return nullptr;
+            void* memory = NodePool::Allocate();
+            return ::new (memory) Node(std::move(value));
+        }
+
+        static void FreeNode(Node* node) noexcept {
+            node->~Node();
+            NodePool::Deallocate(node);
+        }
+
+        // Adjust a node's count; the change that brings it to zero frees it
+        static void Unref(Node* node, int64_t delta) noexcept {
+            if (node->count.fetch_add(delta, std::memory_order_acq_rel) + delta == 0)
+                FreeNode(node);
+        }
+
+        // Reader side of Unref: a node that reaches zero drops its snapshot now
+        // and leaves its memory for a writer
+        void Release(Node* node) const noexcept {
+            if (node->count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            node->value = nullptr;
+            Node* head = retired_.load(std::memory_order_relaxed);
+            do {
+                node->next = head;
+            } while (!retired_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        void FreeRetired() noexcept {
+            Node* node = retired_.exchange(nullptr, std::memory_order_acquire);
+            while (node) {
+                Node* next = node->next;
+                FreeNode(node);
+                node = next;
+            }
+        }
+
+        // Claim the current node so it stays alive until Unclaim
+        Node* Claim() const noexcept {
+            uint64_t previous = const_cast<std::atomic<uint64_t>&>(slot_).fetch_add(one_claim, std::memory_order_acquire);
+            assert(ClaimsOf(previous) + 1 < (uint64_t(1) << (64 - pointer_bits)) && "Too many concurrent readers");
+            return NodeOf(previous);
+        }
+
+        void Unclaim(Node* node) const noexcept {
+            auto& slot = const_cast<std::atomic<uint64_t>&>(slot_);
+            uint64_t current = slot.load(std::memory_order_relaxed);
+            while (NodeOf(current) == node) {
+                // Claims on a null slot may already have been discarded by a writer
+                if (!node && ClaimsOf(current) == 0) return;
+                if (slot.compare_exchange_weak(current, current - one_claim, std::memory_order_release, std::memory_order_relaxed))
+                    return;
+            }
+            // The node was replaced and our claim moved into its count
+            if (node) Release(node);
+        }
+
+        // Settle a node just taken out of the slot along with its claims
+        static void Retire(uint64_t slot) noexcept {
+            if (Node* node = NodeOf(slot)) Unref(node, int64_t(ClaimsOf(slot)));
+        }
+
+    public:
+
+        AtomicPtr() noexcept = default;
+
+        explicit AtomicPtr(Ptr<T, CountPolicy> value) : slot_(Pack(MakeNode(std::move(value)))) {}
+
+        AtomicPtr(const AtomicPtr&) = delete;
+        AtomicPtr& operator=(const AtomicPtr&) = delete;
+
+        ~AtomicPtr() {
+            Retire(slot_.load(std::memory_order_acquire));
+            FreeRetired();
+        }
+
+        Ptr<T, CountPolicy> Load() const {
+            Node* node = Claim();
+            Ptr<T, CountPolicy> value = node ? node->value : Ptr<T, CountPolicy>();
+            Unclaim(node);
+            return value;
+        }
+
+        void Store(Ptr<T, CountPolicy> value) {
+            Exchange(std::move(value));
+        }
+
+        Ptr<T, CountPolicy> Exchange(Ptr<T, CountPolicy> value) {
+            FreeRetired();
+            Node* fresh = MakeNode(std::move(value));
+            uint64_t previous = slot_.exchange(Pack(fresh), std::memory_order_acq_rel);
+            Node* node = NodeOf(previous);
+            if (!node) return Ptr<T, CountPolicy>();
+
+            // Safe to read: the node's count cannot reach zero before Retire
+            Ptr<T, CountPolicy> old = node->value;
+            Retire(previous);
+            return old;
+        }
+
+        // Replace the stored Ptr with desired if it points at the same object as
+        // expected. On failure expected is updated to the current value.
+        bool CompareExchange(Ptr<T, CountPolicy>& expected, Ptr<T, CountPolicy> desired) {
+            FreeRetired();
+            Node* fresh = MakeNode(std::move(desired));
+            for (;;) {
+                Node* node = Claim();
+                T* current = node ? node->value.ptr_ : nullptr;
+                if (current != expected.ptr_) {
+                    expected = node ? node->value : Ptr<T, CountPolicy>();
+                    Unclaim(node);
+                    if (fresh) FreeNode(fresh);
+                    return false;
+                }
+
+                uint64_t slot = slot_.load(std::memory_order_relaxed);
+                while (NodeOf(slot) == node) {
+                    if (slot_.compare_exchange_weak(slot, Pack(fresh), std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        // Our own claim was among those taken off the slot
+                        if (node) Unref(node, int64_t(ClaimsOf(slot)) - 1);
+                        return true;
+                    }
+                }
+
+                // Another writer got there first; try again against its value
+                if (node) Unref(node, -1);
+            }
+        }
+
+        // Whether Load is lock-free; writers may still lock inside the Pool
+        bool IsLockFree() const noexcept {
+            return std::atomic<uint64_t>::is_always_lock_free && std::atomic<Node*>::is_always_lock_free;
+        }
+
+    };
+
+    namespace ptr_detail {
+
+        template <typename T, typename CountPolicy>
+        const void* AddressOf(const Ptr<T, CountPolicy>& ptr) noexcept {
+            if constexpr (std::is_array_v<T>)
+                return ptr.data();
+            else
+                return ptr.Raw();
+        }
+
+        inline const void* AddressOf(const void* ptr) noexcept {
+            return ptr;
+        }
+
+    }
+
+    // Transparent hash and comparators for containers keyed by Ptr, so a raw
+    // pointer can be looked up without making a Ptr and touching its count:
+    //   unordered_set<Ptr<Node>, PtrHash, PtrEqual> nodes;
+    //   nodes.find(raw);
+    // Hashing goes by address, so look up with the same pointer type the keys
+    // hold; a base pointer into a derived object may sit at another address.
+    struct PtrHash {
+        using is_transparent = void;
+
+        template <typename P>
+        size_t operator()(const P& ptr) const noexcept {
+            return std::hash<const void*>()(ptr_detail::AddressOf(ptr));
+        }
+    };
+
+    struct PtrEqual {
+        using is_transparent = void;
+
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const noexcept {
+            return a == b;
+        }
+    };
+
+    struct PtrLess {
+        using is_transparent = void;
+
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const noexcept {
+            if constexpr (std::is_pointer_v<A> && std::is_pointer_v<B>)
+                return std::less<>()(a, b);
+            else
+                return a < b;
+        }
+    };
+
+    template <typename T, typename CountPolicy>
+    struct std::hash<::Ptr<T, CountPolicy>> {
+        size_t operator()(const ::Ptr<T, CountPolicy>& ptr) const noexcept {
+            return PtrHash()(ptr);
+        }
     };
 
+    // A Ptr is written as nothing more than its object's reference: no class
+    // info or version, and no tracking of the Ptr itself. This keeps binary
+    // archives down to one object id per Ptr.
+    namespace boost {
+    namespace serialization {
+
+        template <typename T, typename CountPolicy>
+        struct implementation_level_impl<const ::Ptr<T, CountPolicy>> {
+            typedef mpl::integral_c_tag tag;
+            typedef mpl::int_<object_serializable> type;
+            BOOST_STATIC_CONSTANT(int, value = type::value);
+        };
+
+        template <typename T, typename CountPolicy>
+        struct tracking_level<::Ptr<T, CountPolicy>> {
+            typedef mpl::integral_c_tag tag;
+            typedef mpl::int_<track_never> type;
+            BOOST_STATIC_CONSTANT(int, value = type::value);
+        };
+
+    }
+    }
+
 #endif